@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+# compile airports.csv into airports.bin, which the firmware loads with one
+# read and no parsing (see src/airport_db.h for the format).
+#
+# usage: airportdb.py [airports.csv [airports.bin]]
+#
+# copy the result next to airports.csv on the SD card, or flash it to an
+# 'airports' data partition.
+import sys, struct, zlib
+
+MAGIC = 0x42445041      # 'APDB'
+VERSION = 2
+NO_STRING = 0xffffffff
+
+def parse(path):
+    airports = []
+    with open(path) as f:
+        count = int(f.readline().split(',')[0])
+        for line in f:
+            line = line.strip()
+            if not line:
+                continue
+            fields = line.split(',')
+            name, _, weather = fields[0].partition('=')
+            airports.append((name, weather or None, fields[1],
+                float(fields[2]), float(fields[3]), float(fields[4] or 0)))
+    if len(airports) != count:
+        print('%s: says %d airports, has %d' % (path, count, len(airports)), file=sys.stderr)
+    return airports
+
+def compile(airports, source):
+    strings = bytearray()
+    offsets = {}
+    def string(s):
+        if s is None:
+            return NO_STRING
+        if s not in offsets:
+            offsets[s] = len(strings)
+            strings.extend(s.encode('utf-8') + b'\0')
+        return offsets[s]
+
+    records = bytearray()
+    for name, weather, full_name, x, y, elevation in airports:
+        records += struct.pack('<IIIfff', string(name), string(weather), string(full_name), x, y, elevation)
+    body = bytes(records + strings)
+    # the firmware checks these against the airports.csv next to the image,
+    # and uses that instead if it has changed.
+    header = struct.pack('<IHHIIII', MAGIC, VERSION, len(airports), len(strings), zlib.crc32(body),
+        len(source), zlib.crc32(source))
+    return header + body
+
+def main():
+    src = sys.argv[1] if len(sys.argv) > 1 else 'airports.csv'
+    dst = sys.argv[2] if len(sys.argv) > 2 else src.rsplit('.', 1)[0] + '.bin'
+    airports = parse(src)
+    with open(src, 'rb') as f:
+        source = f.read()
+    image = compile(airports, source)
+    with open(dst, 'wb') as f:
+        f.write(image)
+    print('%s: %d airports, %d bytes' % (dst, len(airports), len(image)))
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,141 @@
+#include <Arduino.h>
+#include <esp_partition.h>
+#include "airport_db.h"
+#include "filesystem.h"
+#include "log.h"
+
+#if CONFIG_IDF_TARGET_ESP32S3
+#include "esp32s3/rom/crc.h"
+#else
+#include "rom/crc.h"
+#endif
+
+// string 'off' in the table, or NULL if it's out of range.
+static char *db_string(const char *strings, uint32_t size, uint32_t off)
+{
+    if (off >= size) return NULL;
+    return (char*) strings + off;
+}
+
+// true unless there's an airports.csv, and it isn't the one the image was
+// compiled from.  the size is enough to tell most edits; if it's the same,
+// the crc32 has to be too.
+static bool matches_csv(const airport_db_header_t *hdr)
+{
+    FILE *f = fopen(data_path(AIRPORT_CSV_FILE), "r");
+    if (f == NULL) return true;     // the image is all there is
+    fseek(f, 0, SEEK_END);
+    uint32_t size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint32_t crc = 0;
+    if (size == hdr->source_size) {
+        uint8_t buf[512];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), f)) > 0) crc = crc32_le(crc, buf, n);
+    }
+    fclose(f);
+    if (size == hdr->source_size && crc == hdr->source_crc) return true;
+    logWarn("load_airport_db: %s has changed since the airport database was compiled; "
+        "using it instead (rerun airportdb.py)\n", AIRPORT_CSV_FILE);
+    return false;
+}
+
+// check the image, and point a new airports array at it.
+static int use_image(const uint8_t *image, size_t size, airport_t *&airports)
+{
+    const airport_db_header_t *hdr = (const airport_db_header_t*) image;
+    if (size < sizeof(*hdr) || hdr->magic != AIRPORT_DB_MAGIC || hdr->version != AIRPORT_DB_VERSION) {
+        logError("load_airport_db: not a version %d airport database\n", AIRPORT_DB_VERSION);
+        return -1;
+    }
+    size_t body = hdr->count * sizeof(airport_db_record_t) + hdr->strings_size;
+    if (sizeof(*hdr) + body > size || crc32_le(0, image + sizeof(*hdr), body) != hdr->crc) {
+        logError("load_airport_db: airport database is damaged\n");
+        return -1;
+    }
+    const airport_db_record_t *records = (const airport_db_record_t*)(hdr + 1);
+    const char *strings = (const char*)(records + hdr->count);
+    if (hdr->strings_size == 0 || strings[hdr->strings_size - 1] != '\0') {
+        logError("load_airport_db: bad string table\n");
+        return -1;
+    }
+    if (!matches_csv(hdr)) return -1;
+
+    airport_t *a = (airport_t*) calloc(hdr->count, sizeof(airport_t));
+    if (a == NULL) {
+        logError("load_airport_db: failed to allocate %d airports\n", hdr->count);
+        return -1;
+    }
+    for (int i = 0; i < hdr->count; i++) {
+        const airport_db_record_t *r = records + i;
+        a[i].name = db_string(strings, hdr->strings_size, r->name);
+        a[i].full_name = db_string(strings, hdr->strings_size, r->full_name);
+        a[i].weather = r->weather == AIRPORT_DB_NO_STRING ? NULL : db_string(strings, hdr->strings_size, r->weather);
+        a[i].x = r->x;
+        a[i].y = r->y;
+        a[i].elevation = r->elevation;
+        if (a[i].name == NULL || a[i].full_name == NULL) {
+            logError("load_airport_db: bad string offset in record %d\n", i);
+            free(a);
+            return -1;
+        }
+    }
+    airports = a;
+    return hdr->count;
+}
+
+// the image, straight from flash.  nothing is copied; the mapping stays
+// for good.
+static int map_partition(airport_t *&airports)
+{
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, AIRPORT_DB_PARTITION);
+    if (part == NULL) return -1;
+    const void *image;
+    spi_flash_mmap_handle_t handle;
+    if (esp_partition_mmap(part, 0, part->size, SPI_FLASH_MMAP_DATA, &image, &handle) != ESP_OK) {
+        logError("load_airport_db: can't map partition '%s'\n", AIRPORT_DB_PARTITION);
+        return -1;
+    }
+    int n = use_image((const uint8_t*) image, part->size, airports);
+    if (n < 0) spi_flash_munmap(handle);
+    return n;
+}
+
+// the image, from the data directory, in one read.
+static int read_file(airport_t *&airports)
+{
+    FILE *f = fopen(data_path(AIRPORT_DB_FILE), "r");
+    if (f == NULL) return -1;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *image = (uint8_t*) malloc(size > 0 ? size : 1);
+    if (image == NULL || fread(image, 1, size, f) != (size_t) size) {
+        logError("load_airport_db: can't read %s (%ld bytes)\n", AIRPORT_DB_FILE, size);
+        free(image);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    int n = use_image(image, size, airports);
+    if (n < 0) free(image);
+    return n;
+}
+
+// not threadsafe (startup only)
+int load_airport_db(airport_t *&airports)
+{
+    uint32_t start = millis();
+    uint32_t heap = esp_get_free_heap_size();
+    const char *from = "partition '" AIRPORT_DB_PARTITION "'";
+    int n = map_partition(airports);
+    if (n < 0) {
+        from = AIRPORT_DB_FILE;
+        n = read_file(airports);
+    }
+    if (n >= 0) {
+        logInfo("load_airport_db: %d airports from %s in %u ms, free heap %u -> %u\n",
+            n, from, millis() - start, heap, esp_get_free_heap_size());
+    }
+    return n;
+}
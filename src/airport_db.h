@@ -0,0 +1,50 @@
+#ifndef _H_AIRPORT_DB_
+#define _H_AIRPORT_DB_
+
+#include <stdint.h>
+#include "airports.h"
+
+// airports.csv, compiled by airportdb.py into an image that's used as-is:
+//   header
+//   airport_db_record_t[count]
+//   string table ('\0' terminated strings, referenced by offset)
+// all little endian.  the crc covers everything after the header.  the
+// header also has the size and crc32 of the airports.csv it was compiled
+// from; if there's an airports.csv that doesn't match, it wins.
+
+#define AIRPORT_DB_FILE "airports.bin"          // in the data directory
+#define AIRPORT_DB_PARTITION "airports"         // or a data partition with this label
+#define AIRPORT_CSV_FILE "airports.csv"         // what it was compiled from
+
+#define AIRPORT_DB_MAGIC (0x42445041)           // 'APDB'
+#define AIRPORT_DB_VERSION (2)
+#define AIRPORT_DB_NO_STRING (0xffffffff)
+
+struct airport_db_header_t {
+    uint32_t magic;         // AIRPORT_DB_MAGIC
+    uint16_t version;       // AIRPORT_DB_VERSION
+    uint16_t count;         // records
+    uint32_t strings_size;  // bytes in the string table
+    uint32_t crc;           // crc32 of the records and strings
+    uint32_t source_size;   // airports.csv, in bytes
+    uint32_t source_crc;    // crc32 of airports.csv
+};
+
+struct airport_db_record_t {
+    uint32_t name;          // string offsets
+    uint32_t weather;       // AIRPORT_DB_NO_STRING if it's the same as name
+    uint32_t full_name;
+    float x;
+    float y;
+    float elevation;
+};
+
+// fill in 'airports' (calloc'd here) from the image, mapped from the
+// partition if there is one, otherwise read from the file.  the airports'
+// strings point into the image, which is never freed.  returns the number
+// of airports, or -1 if there's no usable image, or it's older than
+// airports.csv (use airports.csv).
+// not threadsafe (startup only)
+int load_airport_db(airport_t *&airports);
+
+#endif // _H_AIRPORT_DB_
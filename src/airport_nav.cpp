@@ -0,0 +1,148 @@
+#include <Arduino.h>
+#include <float.h>
+#include <math.h>
+#include "airport_nav.h"
+#include "log.h"
+
+// neighbors[i * NAV_DIRS + dir]
+static int16_t *neighbors;
+static int num_nav;
+
+// the airports, bucketed by position.  only used while building 'neighbors'.
+struct nav_grid_t {
+    float min_x, min_y;
+    float cell;             // cells are square, so a ring of cells is a distance bound
+    int w, h;
+    int *start;             // cell c's airports are items[start[c] .. start[c+1]]
+    int *items;
+};
+
+static int cell_x(const nav_grid_t &g, float x)
+{
+    int cx = (int)((x - g.min_x) / g.cell);
+    return cx < 0 ? 0 : cx >= g.w ? g.w - 1 : cx;
+}
+
+static int cell_y(const nav_grid_t &g, float y)
+{
+    int cy = (int)((y - g.min_y) / g.cell);
+    return cy < 0 ? 0 : cy >= g.h ? g.h - 1 : cy;
+}
+
+static bool build_grid(nav_grid_t &g, const airport_t *airports, int n)
+{
+    float max_x = -FLT_MAX, max_y = -FLT_MAX;
+    g.min_x = g.min_y = FLT_MAX;
+    for (int i = 0; i < n; i++) {
+        if (airports[i].x < g.min_x) g.min_x = airports[i].x;
+        if (airports[i].y < g.min_y) g.min_y = airports[i].y;
+        if (airports[i].x > max_x) max_x = airports[i].x;
+        if (airports[i].y > max_y) max_y = airports[i].y;
+    }
+    // about one airport per cell.
+    float span = fmaxf(max_x - g.min_x, max_y - g.min_y);
+    int side = (int) ceilf(sqrtf((float) n));
+    g.cell = span > 0 ? span / side : 1;
+    g.w = (int)((max_x - g.min_x) / g.cell) + 1;
+    g.h = (int)((max_y - g.min_y) / g.cell) + 1;
+
+    g.start = (int*) calloc(g.w * g.h + 1, sizeof(int));
+    g.items = (int*) malloc(n * sizeof(int));
+    if (g.start == NULL || g.items == NULL) return false;
+    // counting sort by cell.
+    for (int i = 0; i < n; i++) g.start[cell_y(g, airports[i].y) * g.w + cell_x(g, airports[i].x) + 1]++;
+    for (int c = 0; c < g.w * g.h; c++) g.start[c + 1] += g.start[c];
+    int *fill = (int*) malloc(g.w * g.h * sizeof(int));
+    if (fill == NULL) return false;
+    memcpy(fill, g.start, g.w * g.h * sizeof(int));
+    for (int i = 0; i < n; i++) g.items[fill[cell_y(g, airports[i].y) * g.w + cell_x(g, airports[i].x)]++] = i;
+    free(fill);
+    return true;
+}
+
+// is 'ap' in direction 'dir' from 'cur'?  (same axis position counts)
+static bool in_direction(const airport_t *cur, const airport_t *ap, int dir)
+{
+    switch (dir) {
+        case NAV_UP: return ap->y <= cur->y;
+        case NAV_DOWN: return ap->y >= cur->y;
+        case NAV_LEFT: return ap->x <= cur->x;
+        case NAV_RIGHT: return ap->x >= cur->x;
+        default: return true;
+    }
+}
+
+// the closest airport to 'from' in 'dir'.  distance along the 'wrong' axis
+// costs double (so going up prefers what's above over what's off to the
+// side), and ties go to the lower index.
+static int closest(const nav_grid_t &g, const airport_t *airports, int from, int dir)
+{
+    const airport_t *cur = airports + from;
+    float xmult = (dir == NAV_UP || dir == NAV_DOWN) ? 2 : 1;
+    float ymult = (dir == NAV_LEFT || dir == NAV_RIGHT) ? 2 : 1;
+    int cx = cell_x(g, cur->x), cy = cell_y(g, cur->y);
+    int max_ring = g.w > g.h ? g.w : g.h;
+
+    float min_dist = FLT_MAX;
+    int best = -1;
+    for (int ring = 0; ring <= max_ring; ring++) {
+        // everything in this ring (and beyond) is at least (ring - 1) cells
+        // away, and the penalties only make that bigger.
+        float bound = (ring - 1) * g.cell;
+        if (best >= 0 && ring > 1 && bound * bound > min_dist) break;
+
+        for (int y = cy - ring; y <= cy + ring; y++) {
+            if (y < 0 || y >= g.h) continue;
+            // whole rows at the top and bottom of the ring, just the ends in between.
+            int step = (y == cy - ring || y == cy + ring) ? 1 : 2 * ring;
+            if (step == 0) step = 1;
+            for (int x = cx - ring; x <= cx + ring; x += step) {
+                if (x < 0 || x >= g.w) continue;
+                int c = y * g.w + x;
+                for (int k = g.start[c]; k < g.start[c + 1]; k++) {
+                    int i = g.items[k];
+                    if (i == from || !in_direction(cur, airports + i, dir)) continue;
+                    // we're just comparing distances, so no sqrt().
+                    float dx = (airports[i].x - cur->x) * xmult;
+                    float dy = (airports[i].y - cur->y) * ymult;
+                    float dist = dx*dx + dy*dy;
+                    if (dist < min_dist || (dist == min_dist && i < best)) {
+                        min_dist = dist;
+                        best = i;
+                    }
+                }
+            }
+        }
+    }
+    return best;
+}
+
+// not threadsafe (startup only)
+bool nav_begin(const airport_t *airports, int num_airports)
+{
+    if (num_airports <= 0 || num_airports > INT16_MAX) return false;
+    uint32_t start = millis();
+    nav_grid_t g;
+    memset(&g, 0, sizeof(g));
+    neighbors = (int16_t*) malloc(num_airports * NAV_DIRS * sizeof(int16_t));
+    bool ok = neighbors != NULL && build_grid(g, airports, num_airports);
+    if (ok) {
+        for (int i = 0; i < num_airports; i++) {
+            for (int dir = 0; dir < NAV_DIRS; dir++) neighbors[i * NAV_DIRS + dir] = closest(g, airports, i, dir);
+        }
+        num_nav = num_airports;
+        logInfo("nav_begin: %d airports, %dx%d grid, neighbors in %u ms\n", num_airports, g.w, g.h, millis() - start);
+    } else {
+        logError("nav_begin: out of memory for %d airports\n", num_airports);
+    }
+    free(g.start);
+    free(g.items);
+    return ok;
+}
+
+// threadsafe
+int nav_next(int from, int dir)
+{
+    if (from < 0 || from >= num_nav || dir < 0 || dir >= NAV_DIRS) return -1;
+    return neighbors[from * NAV_DIRS + dir];
+}
@@ -0,0 +1,25 @@
+#ifndef _H_AIRPORT_NAV_
+#define _H_AIRPORT_NAV_
+
+#include "airports.h"
+
+// cursor movement between airports.  for every airport, the closest one in
+// each direction is worked out once, at startup, so a key press is just a
+// table lookup, however many airports there are.
+
+#define NAV_ANY (0)     // closest in any direction
+#define NAV_UP (1)      // smaller y
+#define NAV_DOWN (2)
+#define NAV_LEFT (3)    // smaller x
+#define NAV_RIGHT (4)
+#define NAV_DIRS (5)
+
+// 'airports' must not move or change afterwards.
+// not threadsafe (startup only)
+bool nav_begin(const airport_t *airports, int num_airports);
+
+// closest airport to 'from' in direction 'dir' (NAV_XXX), -1 if there isn't one.
+// threadsafe
+int nav_next(int from, int dir);
+
+#endif // _H_AIRPORT_NAV_
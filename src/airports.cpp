@@ -10,8 +10,18 @@
 #include "filesystem.h"
 #include "airports.h"
 #include "metar.h"
-#include "kv_pair.h"
+#include "metar_fields.h"
 #include "prefs.h"
+#include "station_index.h"
+#include "wx_snapshot.h"
+#include "wx_schedule.h"
+#include "fetch_health.h"
+#include "wx_cache.h"
+#include "airport_db.h"
+#include "arena.h"
+#include "airport_nav.h"
+#include "led_fade.h"
+#include "led_anim.h"
 
 #include "esp_metar_map.h"
 
@@ -23,8 +33,12 @@ FASTLED_USING_NAMESPACE
 
 #define LED_TYPE    WS2812
 #define COLOR_ORDER RGB
-static CRGB *leds;         // current color of LEDs, attached to FastLED
-CRGB *t_leds;       // 'double buffer' of LEDs for fading.
+// all three are the LED task's.  frames are worked out in t_leds, and
+// copied to leds with the effects (led_anim.h) on top, so FastLED only ever
+// sends whole frames.  a change of color is an ANIM_CROSSFADE.
+static CRGB *leds;         // front buffer, attached to FastLED
+static CRGB *cur_leds;     // back buffer: current color of LEDs, without effects
+CRGB *t_leds;       // this frame's colors, to compare with cur_leds.
 
 
 int currentBrightness = 0;
@@ -46,11 +60,26 @@ void set_airport_brightness(int val)
 static airport_t *airports;
 int num_airports;
 
-#define WX_STALE_TIME (3600)        // seconds
+static station_index_t name_index;      // airport name -> airport
+static station_index_t wx_index;        // weather station -> airport(s)
 
 static uint32_t prev_ticks = 0;
+
+// the airport the cursor blink (ANIM_BLINK) is on, -1 if none.  LED task only.
+static int blink_led = -1;
+
+// what the LED task costs.  it keeps the totals; airportsLoop() logs them.
+#define LED_STATS_INTERVAL (60*1000)
+static led_stats_t led_stats;
+static led_stats_t logged_stats;        // as of the last log
+static uint32_t led_stats_start;
 static int update_current = -1;
 
+// names from airports.csv.  they're never freed, so they're packed together
+// rather than strdup'd one at a time.
+#define AIRPORT_STRINGS_CHUNK (2048)
+static arena_t airport_strings;
+
 static String nextField(String &line)
 {
     String field;
@@ -65,6 +94,7 @@ static String nextField(String &line)
     return field;
 }
 
+// false if there's no memory for its strings.
 // not threadsafe.
 static bool parse_airport(String line, airport_t *airport)
 {
@@ -77,15 +107,19 @@ static bool parse_airport(String line, airport_t *airport)
     mark = name.indexOf('=');
     if (mark != -1) {
         // show weather from another code for this airport.
-        airport->name = strdup(name.substring(0,mark).c_str());
-        airport->weather = strdup(name.substring(mark+1).c_str());
+        airport->name = arena_strdup(&airport_strings, name.substring(0,mark).c_str());
+        airport->weather = arena_strdup(&airport_strings, name.substring(mark+1).c_str());
     } else {
-        airport->name = strdup(name.c_str());
+        airport->name = arena_strdup(&airport_strings, name.c_str());
         airport->weather = NULL;
     }
 
     // get full name.
-    airport->full_name = strdup(nextField(line).c_str());
+    airport->full_name = arena_strdup(&airport_strings, nextField(line).c_str());
+    if (airport->name == NULL || (mark != -1 && airport->weather == NULL) || airport->full_name == NULL) {
+        logError("parse_airport: out of memory for '%s'\n", name.c_str());
+        return false;
+    }
 
     // x/y coordinates
     airport->x = nextField(line).toFloat();
@@ -102,32 +136,89 @@ static bool parse_airport(String line, airport_t *airport)
 }
 
 
+// the number of airports, or -1 if airports.csv can't be read, or there's
+// no memory for it.
 // not threadsafe.
-int load_airports()
+static int load_airports_csv()
 {
-    String tmp;
+    uint32_t start = millis();
+    uint32_t heap = esp_get_free_heap_size();
+    arena_init(&airport_strings, AIRPORT_STRINGS_CHUNK);
     FILE *f = fopen(data_path("airports.csv"), "r" );
+    if (f == NULL) {
+        logError("load_airports: can't open airports.csv\n");
+        return -1;
+    }
     char linebuf[256];
     fgets(linebuf, sizeof(linebuf), f);
-    num_airports = atoi(linebuf);
-    logInfo("loadAirports: %d airports\n", num_airports);
-    airports = (airport_t*)calloc(num_airports, sizeof(airport_t));
-    for (int i = 0; i < num_airports; i++ ) {
+    int n = atoi(linebuf);
+    logInfo("loadAirports: %d airports\n", n);
+    airports = (airport_t*)calloc(n, sizeof(airport_t));
+    if (airports == NULL) {
+        logError("load_airports: failed to allocate %d airports\n", n);
+        fclose(f);
+        return -1;
+    }
+    for (int i = 0; i < n; i++ ) {
         fgets(linebuf, sizeof(linebuf), f);
-        parse_airport(String(linebuf),&(airports[i]));
+        if (!parse_airport(String(linebuf),&(airports[i]))) {
+            free(airports);
+            airports = NULL;
+            fclose(f);
+            return -1;
+        }
     }
     fclose(f);
+    logInfo("load_airports: %d airports from airports.csv in %u ms, free heap %u -> %u\n",
+        n, millis() - start, heap, esp_get_free_heap_size());
+    return n;
+}
+
+// from the compiled database (airportdb.py) if there is one, otherwise
+// from airports.csv.
+// not threadsafe.
+int load_airports()
+{
+    num_airports = load_airport_db(airports);
+    if (num_airports < 0) num_airports = load_airports_csv();
+    // an empty map, rather than a half loaded one.
+    if (num_airports < 0) num_airports = 0;
+
+    // index by name, and by weather station.  an airport with an alias
+    // (KXXX=KYYY) is found by KXXX, and gets weather from KYYY; several
+    // airports can share the same weather station.
+    station_index_init(name_index, num_airports);
+    station_index_init(wx_index, num_airports);
+    for (int i = 0; i < num_airports; i++ ) {
+        airport_t *a = airports + i;
+        station_index_add(name_index, a->name, i);
+        station_index_add(wx_index, a->weather ? a->weather : a->name, i);
+    }
+    nav_begin(airports, num_airports);
     return num_airports;
 }
 
 // not threadsafe.
 static int _airport_index(const char *name)
 {
-    for (int i = 0; i < num_airports; i++ )
-    {
-        if (strcmp(name,airports[i].name)== 0) { return i; }
-    }
-    return -1;
+    int iter = -1;
+    return station_index_find(name_index, name, strlen(name), iter);
+}
+
+// find airports that take their weather from 'station' (which doesn't need
+// to be '\0' terminated).  set 'iter' to -1 to start; returns -1 when there
+// are no more.  the index is built once in load_airports(), and never changes.
+// threadsafe.
+int station_airport_index(const char *station, int len, int &iter)
+{
+    return station_index_find(wx_index, station, len, iter);
+}
+
+// index of 'airport' in the airport list.  the list never moves once loaded.
+// threadsafe.
+int airport_number(const airport_t *airport)
+{
+    return airport - airports;
 }
 
 // not threadsafe.
@@ -172,88 +263,6 @@ airport_t *get_airport(int index)
     return rc;
 }
 
-typedef bool (*field_setter)(airport_t *airport, const char *key, const char *val);
-
-// not threadsafe
-static bool set_int(int &out, const char *val, int def_val)
-{
-    if (strlen(val) == 0) { out = def_val; return true; }
-    out = atoi(val);
-    return true;
-}
-
-// not threadsafe
-static bool set_float(float &out, const char *val, float def_val)
-{
-    if (strlen(val) == 0) { 
-        logDebug("set_float: returning default (%f)\n", def_val);
-        out = def_val; 
-        return true; 
-    }
-    out = strtof(val,NULL);
-    logDebug("set_float: '%s' parses to %f\n", val, out );
-    return true;
-}
-
-// not threadsafe
-static bool set_charbuf(char *&out, const char *val, const char *def_val)
-{
-    if (out != NULL) free(out);
-    out = NULL;
-    if (val == NULL || strlen(val) == 0) val = def_val;
-    if (val != NULL) out = strdup(val);
-    return true;
-}
-
-// not threadsafe
-static bool set_wind_dir(airport_t *airport, const char *key, const char *val)
-{
-    return set_int(airport->wind_dir, val, -1);
-}
-
-// not threadsafe
-static bool set_wind_speed(airport_t *airport, const char *key, const char *val)
-{
-    return set_int(airport->wind_speed, val, -1);
-}
-
-// not threadsafe
-static bool set_wind_gust(airport_t *airport, const char *key, const char *val)
-{
-    return set_int(airport->wind_gust, val, -1);
-}
-
-// not threadsafe
-static bool set_vis(airport_t *airport, const char *key, const char *val)
-{
-    return set_float(airport->vis, val, -1.0);
-}
-
-// not threadsafe
-static bool set_altimiter(airport_t *airport, const char *key, const char *val)
-{
-    return set_float(airport->altimiter, val, -1.0);
-}
-
-/* in a METAR, this is station elevation, which we don't really care about. 
-static bool set_elevation(airport_t *airport, const char *key, const char *val)
-{
-    return set_float(airport->elevation, val, 0);
-}
-*/
-
-kv_pair<int> sky_cover_map[] = {
-    { "SKC", CLOUD_SKC },
-    { "CLR", CLOUD_CLR },
-    { "CAVOK", CLOUD_CAVOK },
-    { "FEW", CLOUD_FEW },
-    { "SCT", CLOUD_SCT },
-    { "BKN", CLOUD_BKN },
-    { "OVC", CLOUD_OVC },
-    { "OVX", CLOUD_OVX },
-    { NULL,  -1 },
-};
-
 const char *sky_cover[] = {
     "SKC", // CLOUD_SKC
     "CLR", // CLOUD_CLR 
@@ -265,146 +274,69 @@ const char *sky_cover[] = {
     "OVX", // CLOUD_OVX 
 };
 
-// tricky, because the columns 'sky_cover' and 'cloud_base_ft_agl' appear
-// three times in the CSV file we get from the METAR.  we store as an array
-// clouds[3].  So we need to know when to reset the index counter. which we do when
-// we start setting columns.
-// the report SHOULD also always give 'sky_cover' first, so we increment cloud_idx
-// here in set_clouds once we've seen cloud_base_ft_agl
-// note that this handler is called for both keys!
-// not threadsafe
-static bool set_clouds(airport_t *airport, const char *key, const char *val)
-{
-    if (airport->cloud_idx >= WX_CLOUD_RECORDS ) return false; 
-    logDebug("%s[%d] = %s\n", key, airport->cloud_idx, val);
-    clouds_t *c = airport->clouds + airport->cloud_idx;
-    switch(key[0]) {
-        case 's':       // sky_cover
-            {
-                auto sc = match_kv( sky_cover_map, val );
-                c->sky_cover = sc;
-            }
-            break;
-        case 'c':       // cloud_base_ft_agl
-            set_int(c->altitude, val, -1);
-            airport->cloud_idx++;
-            break;
-    }
-    return true;
-}
-
-// not threadsafe
-static bool set_temp(airport_t *airport, const char *key, const char *val)
-{
-    return set_float(airport->temp_c, val, -999 );
-}
-
-// not threadsafe
-static bool set_dew(airport_t *airport, const char *key, const char *val)
-{
-    return set_float(airport->dew_c, val, -999 );
-}
-
-// not threadsafe
-static bool set_report_time(airport_t *airport, const char *key, const char *val)
-{
-    return true;
-}
-
-// not threadsafe
-static bool set_metar(airport_t *airport, const char *key, const char *val)
-{
-    return set_charbuf(airport->metar, val, "");
-}
-
-// 'public' interface.
-// threadsafe
-void set_airport_metar(airport_t *airport, const char *val)
-{
-    _lock();
-    set_charbuf(airport->metar, val, "");
-    _release();
-}
-
-kv_pair<int> flight_category_map[] = {
-    { "VFR",  WX_COND_VFR },
-    { "MVFR", WX_COND_MVFR },
-    { "IFR",  WX_COND_IFR },
-    { "LIFR", WX_COND_LIFR },
-    { NULL, -1 },
-};
+// set by airportsBegin() if wx_cache_load() couldn't tell how old its
+// weather is.  parse task only, after that.
+static bool cached_wx;
+
+// build the next weather snapshot from the staged records, and publish it.
+// airports in 'batch' (NULL terminated) that didn't get a record keep what
+// they had -- either there was nothing newer, or the fetch failed, and the
+// last good report beats none -- unless that is older than METAR_MAX_AGE.
+// if the fetch failed ('ok' false), the batch isn't rescheduled: it stays
+// due, and fetch_health decides when to try again.
+// the records' metar text is copied into the snapshot's arena, and the
+// staging arena is reset.
+// readers never wait on this, and it takes no locks.
+// not threadsafe (parse task only)
+void commit_airport_wx(airport_t **batch, wx_record_t *records, int n, bool ok)
+{
+    wx_snapshot_t *snap = wx_begin_update();
+    time_t now;
+    time(&now);
 
-// not threadsafe
-static bool set_flight_category(airport_t *airport, const char *key, const char *val)
-{
-    logInfo("Set flight category %s = %s\n", airport->name, val);
-    airport->wx_cond = (int) match_kv(flight_category_map, val);
-    return true;
-}
+    for (airport_t **a = batch; *a; a++) {
+        wx_t *wx = snap->wx + (*a - airports);
+        if (wx->obs_time < now - METAR_MAX_AGE) wx->valid_metar = false;
+    }
 
-  /*
-  float press_alt;
-  time_t lastMetar; // when did we last check METAR for this airport
-  bool lightning;   // if true, lightning is present.
-  int lastFlash;    // last lightning flash, in ticks()
-  */
-kv_pair<field_setter> metar_fields[] = {
-    { "raw_text", set_metar },
-    // { "station_id", ... },
-    // { "observation_time", set_obs_time }, // V: 2023-03-18T23:47:00Z
-    // {"latitude", set_latitude }, //  V: 37.33
-    // {"longitude", set_longitude }, //  V: -121.82
-    {"temp_c", set_temp },                  //  V: 21.0
-    {"dewpoint_c", set_dew },               //  V: 6.0
-    {"wind_dir_degrees", set_wind_dir },    //  V: 160
-    {"wind_speed_kt", set_wind_speed },     //  V: 12
-    {"wind_gust_kt", set_wind_gust },       //  V:
-    {"visibility_statute_mi", set_vis },    //  V: 10.0
-    {"altim_in_hg", set_altimiter },        //  V: 29.940945
-    // {"sea_level_pressure_mb", ... }      //  V:
-    // {"corrected", ... },                 //  V:
-    // {"auto", ... },                      //  V:
-    // {"auto_station", ... },              //  V:
-    // {"maintenance_indicator_on", ... },  //  V:
-    // {"no_signal", ... },                 //  V:
-    // {"lightning_sensor_off", ... },      //  V:
-    // {"freezing_rain_sensor_off", ... },  //  V:
-    // {"present_weather_sensor_off", ... },//  V:
-    // {"wx_string", ... },                 //  V: 
-    {"sky_cover", set_clouds },             //  V: OVC
-    {"cloud_base_ft_agl", set_clouds },     //  V: 15000
-    {"flight_category", set_flight_category },  // V: VFR
-    // {"three_hr_pressure_tendency_mb", ... }, //  V:
-    // {"maxT_c", ... },                //  V:
-    // {"minT_c", ... },                //  V:
-    // {"maxT24hr_c", ... },            //  V:
-    // {"minT24hr_c", ... },            //  V:
-    // {"precip_in", ... },             //  V:
-    // {"pcp3hr_in", ... },             //  V:
-    // {"pcp6hr_in", ... },             //  V:
-    // {"pcp24hr_in", ... },            //  V:
-    // {"snow_in", ... },               //  V:
-    // {"vert_vis_ft", ... },           // V:
-    // {"metar_type", ... },            //  V: METAR
-    // {"elevation_m", set_elevation },           // V: 37.0 (station elevation -- we don't care)
-    { NULL, NULL }
-};
+    // once the clock's set, weather loaded from the cache before it was
+    // gets aged, whether or not this fetch worked, and whatever's in the
+    // batch.  (if the fetches never get anywhere, this is the only time
+    // those airports are looked at)
+    if (cached_wx && now > WX_CACHE_TIME_VALID) {
+        for (int i = 0; i < snap->count; i++) {
+            wx_t *wx = snap->wx + i;
+            if (!wx->cached) continue;
+            wx->cached = false;
+            if (wx->obs_time < now - METAR_MAX_AGE) {
+                wx->valid_metar = false;
+                wx->metar = NULL;
+            }
+        }
+        cached_wx = false;
+    }
 
-// threadsafe
-static bool _set_airport_kv(airport_t *airport, const char *key, const char *val)
-{
-    field_setter handler = (field_setter) match_kv(metar_fields, key);
-    if (handler == NULL) return false;
-    logDebug("set_airport_kv: Setting %s = %s\n", key, val);
-    return handler(airport, key, val);
-}
+    for (int r = 0; r < n; r++) {
+        wx_record_t *rec = records + r;
+        char *text = NULL;
+        int iter = -1, index;
+        while ((index = station_airport_index(rec->station, strlen(rec->station), iter)) != -1) {
+            wx_t *wx = snap->wx + index;
+            // several airports can share a station, and its text.
+            if (text == NULL && rec->wx.metar) text = arena_strdup(&snap->text, rec->wx.metar);
+            *wx = rec->wx;
+            wx->metar = text;
+        }
+        rec->wx.metar = NULL;
+    }
+    staged_text_reset();
 
-bool set_airport_kv(airport_t *airport, const char *key, const char *val)
-{
-    _lock();
-    auto rc = _set_airport_kv(airport,key,val);
-    _release();
-    return rc;
+    for (airport_t **a = batch; *a; a++) {
+        wx_t *wx = snap->wx + (*a - airports);
+        if (!wx->valid_metar) wx->metar = NULL;
+        if (ok) schedule_result(*a - airports, wx, now);
+    }
+    wx_publish(snap);
 }
 
 static const char *wxConditionStrings[WX_COND_MAX] = { "VFR", "MVFR", "IFR", "LIFR" };
@@ -426,7 +358,10 @@ static CRGB wxConditionLEDColors[WX_COND_MAX] = {
 // yellow means no WX for airport yet.
 static CRGB invalid_wx = CRGB::Yellow;
 static CRGB lightning = CRGB::White;
+static CRGB gust = CRGB(96,96,96);
 static CRGB blink_off = CRGB::Black;
+// weather from the cache that we don't know the age of, yet, at about a third.
+#define CACHED_WX_SCALE (96)
 
 // not threadsafe.
 static bool _show_airport(int n)
@@ -450,83 +385,28 @@ bool show_airport(int n)
 
 // find the closest airport to the current airport, in a given 
 // direction (IR_KEY_{UP,DOWN,LEFT,RIGHT}) -- if 'dir' == 0,
-// just find closest airport.
+// just find closest airport.  (the neighbors are all worked out by
+// nav_begin(), in load_airports())
 // not threadsafe.
 bool _next_airport(char dir)
 {
-    airport_t *cur = airports + prefs.current_airport;
-    float min_dist = FLT_MAX;
-    int closest_index = -1;
-    logDebug("next airport (%d: %s) dir: %c", prefs.current_airport, cur->name, dir);
-    // 'xmult' and 'ymult' are used as 'penalties' for the distance in the 'wrong'
-    // axis my multiplying the distance on that axis. i.e. making it 3 times 
-    // more expensive to go 1KM up/down when looking for the closest east/west 
-    float xmult, ymult;
+    uint32_t start = micros();
+    int nav_dir;
     switch(dir) {
-        case IR_KEY_DOWN:
-        case IR_KEY_UP:
-            xmult = 2; ymult = 1;
-            break;
-        case IR_KEY_LEFT:
-        case IR_KEY_RIGHT:
-            xmult = 1; ymult = 2;
-            break;
-        default:
-            xmult = 1; ymult = 1;
-            break;
-    }
-
-    for ( int i = 0; i < num_airports; i++ ) {
-        airport_t *ap = airports + i;
-        // skip current.
-        if (i == prefs.current_airport) continue;
-
-        switch(dir) {
-            case IR_KEY_UP:
-                if (ap->y > cur->y) {
-                    logDebug("Skipping %s (%s), y=%.2f > %.2f\n", ap->name, ap->full_name, ap->y, cur->y); 
-                    continue;
-                }
-                break;
-            case IR_KEY_DOWN:
-                if (ap->y < cur->y) {
-                    logDebug("Skipping %s (%s), y=%.2f < %.2f\n", ap->name, ap->full_name, ap->y, cur->y); 
-                    continue;
-                }
-                break;
-            case IR_KEY_LEFT:
-                if (ap->x > cur->x) {
-                    logDebug("Skipping %s (%s), x=%.2f > %.2f\n", ap->name, ap->full_name, ap->x, cur->x); 
-                    continue;
-                }
-                break;
-            case IR_KEY_RIGHT:
-                if (ap->x < cur->x) {
-                    logDebug("Skipping %s (%s), x=%.2f < %.2f\n", ap->name, ap->full_name, ap->x, cur->x); 
-                    continue;
-                }
-                break;
-        }
-
-        float dx = (ap->x - cur->x) * xmult;
-        float dy = (ap->y - cur->y) * ymult;
-        // since we're just comparing against other distances,
-        // we don't need the SQRT().
-        float dist = dx*dx + dy*dy;
-
-        if (dist < min_dist) {
-            logDebug("CLOSER: %d: %s (%s) dist=%f (was=%f)\n", i, ap->name, ap->full_name, dist, min_dist );
-            closest_index = i;
-            min_dist = dist;
-        } else {
-            logDebug("%d: %s (%s) dist=%f (closest=%f)\n", i, ap->name, ap->full_name, dist, min_dist );
-        }
+        case IR_KEY_UP: nav_dir = NAV_UP; break;
+        case IR_KEY_DOWN: nav_dir = NAV_DOWN; break;
+        case IR_KEY_LEFT: nav_dir = NAV_LEFT; break;
+        case IR_KEY_RIGHT: nav_dir = NAV_RIGHT; break;
+        default: nav_dir = NAV_ANY; break;
     }
+    int closest_index = nav_next(prefs.current_airport, nav_dir);
     if (closest_index < 0 || closest_index >= num_airports) {
-        logInfo("No close airport found? (%d, min dist: %f)\n", closest_index, min_dist);
+        logInfo("No close airport found? (%d: %s, dir: %c)\n", prefs.current_airport,
+            airports[prefs.current_airport].name, dir);
         return false;
     }
     _show_airport(closest_index);
+    logDebug("next airport %d -> %d dir: %c in %u us\n", prefs.current_airport, closest_index, dir, micros() - start);
     return true;
 }
 
@@ -625,11 +505,16 @@ static void _update_current_airport(bool force = false)
     update_current = -1;
 
     airport_t *a = airports + prefs.current_airport;
+
+    // take a copy of the weather, so we don't hold the snapshot while
+    // loading images.  (wx->metar is only good until wx_release())
+    wx_t cur_wx = wx_acquire(WX_READER_UI)->wx[prefs.current_airport];
+    wx_t *wx = &cur_wx;
     logDebug("update_current_airport: %d (%s; %s)\n", prefs.current_airport, a->name, a->full_name);
 
-    if (a->valid_metar) {
-        p = wxConditionStrings[a->wx_cond];
-        lv_obj_set_style_text_color(ui_AirportCodeLabel, wxConditionColors[a->wx_cond], LV_PART_MAIN | LV_STATE_DEFAULT);
+    if (wx->valid_metar && wx->wx_cond < WX_COND_MAX) {
+        p = wxConditionStrings[wx->wx_cond];
+        lv_obj_set_style_text_color(ui_AirportCodeLabel, wxConditionColors[wx->wx_cond], LV_PART_MAIN | LV_STATE_DEFAULT);
     } else {
         p = "???";
         lv_obj_set_style_text_color(ui_AirportCodeLabel, invalid_wx_txt, LV_PART_MAIN | LV_STATE_DEFAULT);
@@ -638,15 +523,17 @@ static void _update_current_airport(bool force = false)
 
     lv_label_set_text_static(ui_AirportNameLabel, a->full_name);
 
-    logDebug("format metar (%x)\n", a->metar );
+    logDebug("format metar (%x)\n", wx->metar );
     bool valid;
-    if (a->metar == NULL || strlen(a->metar) == 0) {
+    if (wx->metar == NULL || strlen(wx->metar) == 0) {
         p = "METAR: NO DATA" METAR_DOTS;
         valid = false;
     } else {
-        p = sprintfBuf(pBuf, pEnd, "METAR: %s" METAR_DOTS, a->metar );
-        valid = a->valid_metar;
+        p = sprintfBuf(pBuf, pEnd, "METAR: %s" METAR_DOTS, wx->metar );
+        valid = wx->valid_metar;
     }
+    wx->metar = NULL;
+    wx_release(WX_READER_UI);
 
     lv_label_set_text_static( ui_MetarTicker, p );
 
@@ -667,36 +554,36 @@ static void _update_current_airport(bool force = false)
         lv_label_set_text_static( ui_DewpointLabel, p );
         lv_obj_add_flag(ui_windArrowImage, LV_OBJ_FLAG_HIDDEN );
     } else {
-        if (a->wind_dir == 0 && a->wind_speed == 0) {
+        if (wx->wind_dir == 0 && wx->wind_speed == 0) {
             // CALM
             lv_obj_add_flag(ui_windArrowImage, LV_OBJ_FLAG_HIDDEN );
             p = sprintfBuf(pBuf, pEnd, "Calm");
-        } else if (a->wind_dir == 0) {
+        } else if (wx->wind_dir == 0) {
             // VARIABLE
             lv_obj_add_flag(ui_windArrowImage, LV_OBJ_FLAG_HIDDEN );
-            p = sprintfBuf(pBuf, pEnd, "Var.\n%d KTS", a->wind_speed);
+            p = sprintfBuf(pBuf, pEnd, "Var.\n%d KTS", wx->wind_speed);
         } else {
             lv_obj_clear_flag(ui_windArrowImage, LV_OBJ_FLAG_HIDDEN );
-            lv_img_set_angle(ui_windArrowImage, (int)(((a->wind_dir+180) % 360) * 10));
+            lv_img_set_angle(ui_windArrowImage, (int)(((wx->wind_dir+180) % 360) * 10));
             // TODO: calculate pref. runway and xwind component, color arrow accordingly.
             // lv_obj_set_style_img_recolor(ui_windArrowImage, lv_color_hex(0xF8034F), LV_PART_MAIN | LV_STATE_DEFAULT);
-            p = sprintfBuf(pBuf, pEnd, "%d\n%d KTS", a->wind_dir, a->wind_speed);
+            p = sprintfBuf(pBuf, pEnd, "%d\n%d KTS", wx->wind_dir, wx->wind_speed);
         }
-        if (a->wind_gust > 0) {
+        if (wx->wind_gust > 0) {
             pBuf--; // clobber trailing '\0' from previous sprintfBuf.
-            sprintfBuf(pBuf,pEnd, "\nG %d", a->wind_gust);
+            sprintfBuf(pBuf,pEnd, "\nG %d", wx->wind_gust);
         }
         lv_label_set_text_static( ui_WindLabel, p );
 
         // ui_VisibilityLabel
-        p = sprintfBuf(pBuf, pEnd, "%.0f SM", a->vis);
+        p = sprintfBuf(pBuf, pEnd, "%.0f SM", wx->vis);
         lv_label_set_text_static( ui_VisibilityLabel, p );
 
         // ui_CloudsLabel
         p = sprintfBuf(pBuf, pEnd, "");
         bool cover = false;
-        for (int i = 0 ; i < a->cloud_idx; i++ ) {
-            clouds_t *c = a->clouds + i;
+        for (int i = 0 ; i < wx->cloud_idx; i++ ) {
+            clouds_t *c = wx->clouds + i;
             if (c->sky_cover == -1 || c->altitude == -1) break;
             pBuf--;
             cover = true;
@@ -711,125 +598,182 @@ static void _update_current_airport(bool force = false)
         }
 
         // ui_AltimiterLabel
-        float pa = PA(a->altimiter, a->elevation);
+        float pa = PA(wx->altimiter, a->elevation);
         float isa = ISA(pa);
-        float da = DA(pa,a->temp_c,isa);
-        p = sprintfBuf(pBuf, pEnd, "%.2f\" Hg\nDA %d'", a->altimiter, (int)da);
+        float da = DA(pa,wx->temp_c,isa);
+        p = sprintfBuf(pBuf, pEnd, "%.2f\" Hg\nDA %d'", wx->altimiter, (int)da);
         lv_label_set_text_static( ui_AltimiterLabel, p );
 
         // ui_TemperatureLabel
-        p = sprintfBuf(pBuf, pEnd, "%d C\n%d F", (int)a->temp_c, (int)CtoF(a->temp_c));
+        p = sprintfBuf(pBuf, pEnd, "%d C\n%d F", (int)wx->temp_c, (int)CtoF(wx->temp_c));
         lv_label_set_text_static( ui_TemperatureLabel, p );
 
         // ui_DewpointLabel
-        p = sprintfBuf(pBuf, pEnd, "%d C\n%d F", (int)a->dew_c, (int)CtoF(a->dew_c));
+        p = sprintfBuf(pBuf, pEnd, "%d C\n%d F", (int)wx->dew_c, (int)CtoF(wx->dew_c));
         lv_label_set_text_static( ui_DewpointLabel, p );
     }
     logDebug("done. %d/%d bytes used.\n", pEnd - pBuf, AIRPORT_DATA_BUFFER_SIZE );
 }
 
-void ledsOff()
+// the LED task owns the strip, so leds_off() just asks it to blank it.
+static volatile bool leds_off_request = false;
+
+// threadsafe
+void leds_off()
+{
+    leds_off_request = true;
+}
+
+// not threadsafe (LED task only)
+static void _leds_off()
 {
-  for (int i = 0; i < num_airports; i++) { t_leds[i] = leds[i] = CRGB::Black; }
-  FastLED.show();  
+    leds_off_request = false;
+    for (int i = 0; i < num_airports; i++) { t_leds[i] = cur_leds[i] = leds[i] = CRGB::Black; }
+    FastLED.show();
 }
 
 static void airport_refresh_task(void *params);
+static void led_task(void *params);
 
 // not threadsafe
 void airportsBegin()
 {
     // TODO: display something if this fails.
     load_airports();
+    wx_snapshot_begin(num_airports);
+    metar_fields_begin();
+    // last known weather, so the LEDs don't sit yellow until the first refresh.
+    // (before the clock's set, it can't tell how old it is)
+    time_t now;
+    time(&now);
+    cached_wx = wx_cache_load() > 0 && now <= WX_CACHE_TIME_VALID;
+    schedule_begin(num_airports);
+    metarBegin();
 
     // tell FastLED about the LED strip configuration
-    // allocate twice as many as we have airports, because we always fade from t_leds[n] -> leds[n].
-    leds = (CRGB*) calloc(num_airports*2, sizeof(CRGB));
-    t_leds = leds + num_airports;
+    // allocate three per airport: the front buffer, the colors under the effects, and this frame's colors.
+    leds = (CRGB*) calloc(num_airports*3, sizeof(CRGB));
+    cur_leds = leds + num_airports;
+    t_leds = cur_leds + num_airports;
+    anim_begin(num_airports);
 
     FastLED.addLeds<LED_TYPE,FASTLED_DATA_PIN,COLOR_ORDER>(leds, num_airports).setCorrection(UncorrectedColor);
 
     // set master brightness control
     FastLED.setBrightness(10);
-    ledsOff();
+    // the LED task's first frame.
+    leds_off();
 
-    // start airport refresh task.
+    // start airport refresh task.  it does the network half of the fetch
+    // pipeline, so it goes on the same core as the parse task.
     TaskHandle_t handle;
     BaseType_t rc;
-    rc = xTaskCreate(airport_refresh_task, "refresh", 
+    rc = xTaskCreatePinnedToCore(airport_refresh_task, "refresh", 
             10000,      // stack size
             NULL,       // parameters
             tskIDLE_PRIORITY,  // prio
-            &handle);
+            &handle,
+            METAR_CORE);
     if (rc != pdPASS) {
         logError("airportsBegin: failed to start airport_refresh_task\n");
     } else {
         logInfo("airportsBegin: created refresh task\n");
     }
+
+    rc = xTaskCreatePinnedToCore(led_task, "leds",
+            4096,       // stack size
+            NULL,       // parameters
+            LED_PRIORITY,
+            &handle,
+            LED_CORE);
+    if (rc != pdPASS) {
+        logError("airportsBegin: failed to start led_task\n");
+    } else {
+        logInfo("airportsBegin: created LED task\n");
+    }
 }
 
-static bool airport_blink_state = false;
-static int airport_blink_timer = 0;
+// the cursor blinks until airport_blink_until (millis(); 0 is off).
+// written by the UI, read by the LED task, which runs the blink (ANIM_BLINK).
+static volatile uint32_t airport_blink_until = 0;
 static int last_airport = -1;
-static int airport_blink_enable = 0;
 
-// not threadsafe
+// not threadsafe (UI only)
 void airport_blink(bool enable, int how_long)
 {
     if (enable) {
         logInfo("Enable blink %d\n", how_long);
-        airport_blink_enable = how_long;
-        airport_blink_timer = AIRPORT_BLINK_RATE;
-        airport_blink_state = true;
+        airport_blink_until = millis() + how_long;
     } else {
         logInfo("Disable blink\n");
-        airport_blink_enable = 0;
-        airport_blink_timer = 0;
+        airport_blink_until = 0;
     }
 }
 
+// fetch every airport that's due (or nearly due, so they share a request)
 static bool fetch_next_airport()
 {
     time_t now;
     time(&now);
     bool updated = false;
-#define MAX_AIRPORT_UPDATES (32)
     airport_t *updates[MAX_AIRPORT_UPDATES+1];
     int n = 0;
     bool update_cur = false;
 
-    for ( int i = 0 ; i < num_airports; i++ ) {
-        // start with current airport, work our way around.
-        auto num = (prefs.current_airport + i) % num_airports;
-        auto a = airports + num;
-        auto age = now - a->last_metar;
-        if (age > WX_STALE_TIME) {
-            logDebug("[%d] WX for %s is %d seconds old.\n", now, a->name, age);
-            updates[n++] = a;
-            updates[n] = NULL;
-            if (n == MAX_AIRPORT_UPDATES) {
-                logDebug("Updating %d airports...\n", n);
-                _lock();
-                update_airport_wx(updates);
-                n = 0;
-                _release();
-                updated = true;
+    if (metar_bulk_mode()) {
+        // everything comes in one request, so when anything is due, get it all.
+        for ( int i = 0 ; i < num_airports; i++ ) {
+            if (schedule_due(i, now)) {
+                // (unless we're backing off)
+                if (!health_allow(now)) break;
+                logDebug("[%d] WX for %s is due, fetching all.\n", now, airports[i].name);
+                update_all_airport_wx();
+                updated = update_cur = true;
+                break;
+            }
+        }
+    } else {
+        for ( int i = 0 ; i < num_airports; i++ ) {
+            // start with current airport, work our way around.
+            auto num = (prefs.current_airport + i) % num_airports;
+            auto a = airports + num;
+            if (schedule_due(num, now + WX_BATCH_SLACK)) {
+                logDebug("[%d] WX for %s is due.\n", now, a->name);
+                updates[n++] = a;
+                updates[n] = NULL;
+                if (n >= metar_batch_size()) {
+                    // backing off.  the rest stay due.
+                    if (!health_allow(now)) {
+                        n = 0;
+                        break;
+                    }
+                    logDebug("Updating %d airports...\n", n);
+                    update_airport_wx(updates);
+                    n = 0;
+                    updated = true;
+                }
+                // trigger refresh of GUI
+                if (num == prefs.current_airport) update_cur = true;
             }
-            // trigger refresh of GUI
-            if (num == prefs.current_airport) update_cur = true;
         }
     }
     // any left over airports ... update them.
-    if (n > 0) {
+    if (n > 0 && health_allow(now)) {
         logDebug("Updating %d airports (end)...\n", n);
-        _lock();
         update_airport_wx(updates);
         n = 0;
-        _release();
+        updated = true;
     }
+    // the parse task may still be working on the last few.
+    metar_wait();
+    if (updated) wx_cache_save(now);
     if (update_cur == true) {
         show_airport(prefs.current_airport);
     }
+    if (updated || update_cur) {
+        logInfo("refresh: max airport lock hold %u us\n", _lock_max_hold(true));
+        metar_stats_report();
+    }
     return updated;
 }
 
@@ -837,128 +781,207 @@ static void airport_refresh_task(void *params)
 {
     logInfo("airport_refresh_task_begin\n");
     while( true ) {
-        if (WiFi.status() != WL_CONNECTED) {
+        if (metar_needs_network() && WiFi.status() != WL_CONNECTED) {
             logDebug("wifi not ready.  sleeping.\n");
             // wait 3 seconds.
             vTaskDelay( 3000 / portTICK_PERIOD_MS );
             continue;
         }
         // logDebug("fetch next airport.\n");
-        bool fetched = fetch_next_airport();
-        // logDebug("sleeping.\n");
-        if (!fetched) vTaskDelay( 1000 / portTICK_PERIOD_MS );
+        fetch_next_airport();
+
+        // sleep until the next station is due.  wake up at least once a
+        // minute, to notice wifi dropping or the clock being set.
+        time_t now;
+        time(&now);
+        // (or, if fetches are failing, until we're allowed to try again)
+        time_t next = schedule_next_deadline();
+        if (health_next_attempt() > next) next = health_next_attempt();
+        int wait = next - now;
+        if (wait < 1) wait = 1;
+        if (wait > 60) wait = 60;
+        // logDebug("sleeping %d seconds.\n", wait);
+        vTaskDelay( wait * 1000 / portTICK_PERIOD_MS );
     }
 }
 
-// shamelessly stolen from https://gist.github.com/kriegsman/d0a5ed3c8f38c64adcb4837dafb6e690
-void nblendU8TowardU8( uint8_t &cur, const uint8_t &target, uint8_t amount)
+static void hist_add(led_hist_t &h, uint32_t us)
 {
-    if (cur == target) return;
-    if (cur < target) {
-        uint8_t d = target - cur;
-        d = scale8_video(d, amount);
-        cur += d;
-    } else {
-        uint8_t d = target - cur;
-        d = scale8_video(d, amount);
-        cur -= d;
+    int n = 0;
+    while (n < LED_HIST_BUCKETS - 1 && us >= ((uint32_t) LED_HIST_BASE << n)) n++;
+    h.count[n]++;
+    if (us > h.max) h.max = us;
+}
+
+// the buckets that have counts since 'prev', as "<32:1790 <64:10 max 57"
+// (the max is since the LED task started)
+static const char *hist_str(char *&pBuf, char *pEnd, const led_hist_t &h, const led_hist_t &prev)
+{
+    const char *start = pBuf;
+    *pBuf = '\0';
+    for (int n = 0; n < LED_HIST_BUCKETS; n++) {
+        uint32_t count = h.count[n] - prev.count[n];
+        if (count == 0) continue;
+        if (n < LED_HIST_BUCKETS - 1) sprintfBuf(pBuf, pEnd, "<%u:%u ", LED_HIST_BASE << n, count);
+        else sprintfBuf(pBuf, pEnd, ">=%u:%u ", LED_HIST_BASE << n, count);
+        pBuf--;     // sprintfBuf() leaves pBuf after the '\0'
     }
+    sprintfBuf(pBuf, pEnd, "max %u", h.max);
+    return start;
 }
 
-void fadeTowardColor(CRGB& cur, const CRGB& target, uint8_t amount)
+// threadsafe
+void get_led_stats(led_stats_t &stats)
 {
-    nblendU8TowardU8( cur.r, target.r, amount );
-    nblendU8TowardU8( cur.g, target.g, amount );
-    nblendU8TowardU8( cur.b, target.b, amount );
+    memcpy(&stats, &led_stats, sizeof(stats));
 }
 
-void airportsLoop()
+// work out this frame's colors in t_leds, cross-fade the ones that have
+// changed, and put them, with any effects, in leds.  true if the strip
+// needs sending.
+// not threadsafe (LED task only)
+static bool render_leds(uint32_t ticks, int elapsed)
 {
-    int ticks = millis();
-    int elapsed = ticks - prev_ticks;
-
-    // 30hz update rate..
-    if (elapsed < 1000/30) return;
-
-    prev_ticks = ticks;
-
-    _update_current_airport();
-
     // is the blinking 'cursor' enabled?
-    if (airport_blink_enable > 0) {
-        airport_blink_enable -= elapsed;
-        if (airport_blink_enable <= 0) {
-            airport_blink(false);
-        }
-    }
-
-    // blink the cursor.
-    if (airport_blink_timer > 0) {
-        airport_blink_timer -= elapsed;
-        if (airport_blink_timer <= 0) {
-            logInfo("BLINK %d (%d)\n", !airport_blink_state, airport_blink_timer);
-            airport_blink_timer = AIRPORT_BLINK_RATE;
-            airport_blink_state = !airport_blink_state;
-        }
+    uint32_t blink_until = airport_blink_until;
+    int cursor = (blink_until != 0 && (int32_t)(blink_until - ticks) > 0) ? prefs.current_airport : -1;
+    if (cursor != blink_led) {
+        anim_stop(blink_led);
+        blink_led = cursor;
     }
 
-    // update airport colors.
+    // update airport colors.  only the snapshot's render bytes are touched
+    // here; the rest of the weather (and airport_t) stays out of the cache.
     // TODO: dusk/night/dawn
+    const wx_snapshot_t *snap = wx_acquire(WX_READER_LED);
+    const uint8_t *render = snap->render;
+    bool changed = false;
     for (int i = 0; i < num_airports; i++ ) {
-        airport_t *ap = airports + i;
+        uint8_t r = render[i];
+        uint8_t cond = r & WX_RENDER_COND;
 
-        // blink this airport (cursor)?
-        if (i == prefs.current_airport && airport_blink_enable && airport_blink_state) {
-            // logInfo("leds[%s] = blink_off (blink_enable=%d, blink_state=%d, blink_timer=%d)\n",ap->name, airport_blink_enable, airport_blink_state, airport_blink_timer);
-            t_leds[i] = blink_off;
-            continue;
-        }
-        if (ap->metar == NULL || ap->valid_metar == false) {
+        if (!(r & WX_RENDER_VALID)) {
             // no weather for this airport.
-            // if (i == prefs.current_airport) logInfo("leds[%s] = invalid_wx\n",ap->name);
             t_leds[i] = invalid_wx;
-            continue;
+        } else if (cond >= WX_COND_MAX) {
+            // can't happen (set_flight_category() checks); not worth a log every frame.
+            t_leds[i] = CRGB::Violet;
+        } else {
+            // now set LED according to condition.
+            t_leds[i] = wxConditionLEDColors[cond];
+            // we don't know how old it is yet.
+            if (r & WX_RENDER_CACHED) t_leds[i].nscale8_video(CACHED_WX_SCALE);
         }
 
-        // now set LED according to condition.
-
-        // what about lightning?
-        if (ap->lightning) {
-            ap->last_flash -= elapsed;
-            if (ap->last_flash <= 0) {
-                // no fading, so set leds and t_leds to same color.
-                leds[i] = t_leds[i] = lightning;
-                // if (i == prefs.current_airport) logInfo("leds[%s] = lightning\n",ap->name);
-                // 1-3 seconds later for lightning
-                // TODO: lightning intensity?
-                ap->last_flash += random(1000,3000);
-            }
-            continue;
+        // a new color fades in from whatever's showing (leds still has the
+        // last frame), and ends by itself.  (from black, after leds_off())
+        if (t_leds[i] != cur_leds[i]) {
+            cur_leds[i] = t_leds[i];
+            if (i != cursor) anim_start(i, ANIM_CROSSFADE, leds[i]);
+            changed = true;
         }
 
-        if (ap->wx_cond < 0 || ap->wx_cond >= WX_COND_MAX) {
-            logError("Invalid wx_cond for %s: %d\n", ap->name, ap->wx_cond);
-            if (i == prefs.current_airport) logInfo("leds[%s] = ERROR\n",ap->name);
-            t_leds[i] = CRGB::Violet;
-            ap->wx_cond = 0;
+        // and anything on top of that.  blink this airport (cursor)?
+        // then the cross-fade, then lightning, then gusts.
+        int effect = ANIM_NONE;
+        const CRGB *color = NULL;
+        if (i == cursor) {
+            effect = ANIM_BLINK;
+            color = &blink_off;
+        } else if (anim_effect(i) == ANIM_CROSSFADE) {
             continue;
+        } else if ((r & WX_RENDER_VALID) && (r & WX_RENDER_LIGHTNING)) {
+            // TODO: lightning intensity?
+            effect = ANIM_LIGHTNING;
+            color = &lightning;
+        } else if ((r & WX_RENDER_VALID) && (r & WX_RENDER_GUSTY)) {
+            effect = ANIM_GUST;
+            color = &gust;
         }
-        t_leds[i] = wxConditionLEDColors[ap->wx_cond];
-        // if (i == prefs.current_airport) logInfo("leds[%s] = wx cond %d (0x%04.4x)\n",ap->name,ap->wx_cond,leds[i]);
-    }
-
-    for (int i = 0; i < num_airports; i++ ) {
-        // fade LEDs.
-#define FADE_SPEED (5)
-        // fadeTowardColor( leds[i], t_leds[i], FADE_SPEED);
-        leds[i].r = INT_LERP(leds[i].r, t_leds[i].r, 0.2);
-        leds[i].g = INT_LERP(leds[i].g, t_leds[i].g, 0.2);
-        leds[i].b = INT_LERP(leds[i].b, t_leds[i].b, 0.2);
+        if (effect == ANIM_NONE) anim_stop(i);
+        else anim_start(i, effect, *color);
     }
+    wx_release(WX_READER_LED);
 
     if (targetBrightness != currentBrightness) {
-        currentBrightness = INT_LERP(currentBrightness, targetBrightness, 0.1);
+        currentBrightness = fade_step(currentBrightness, targetBrightness, FADE_RATE_BRIGHTNESS);
         FastLED.setBrightness(currentBrightness>>8);
+        changed = true;
     }
-    FastLED.show();
+
+    // the effects go on the front buffer; cur_leds stays as it is underneath.
+    memcpy(leds, cur_leds, num_airports * sizeof(CRGB));
+    if (anim_frame(leds, elapsed)) changed = true;
+    return changed;
+}
+
+// renders a frame every LED_FRAME_MS, and sends it if it's changed.
+// FastLED drives the strip with the RMT peripheral; show() waits on a
+// semaphore for it to finish, so this task sleeps, rather than spins,
+// while the frame goes out.
+static void led_task(void *params)
+{
+    const uint32_t frame_us = LED_FRAME_MS * 1000;
+    TickType_t wake = xTaskGetTickCount();
+    uint32_t due = micros();
+    prev_ticks = millis();
+
+    while (true) {
+        vTaskDelayUntil(&wake, LED_FRAME_MS / portTICK_PERIOD_MS);
+        uint32_t start = micros();
+        due += frame_us;
+        int32_t late = start - due;
+        if (late < 0) late = 0;
+        // a whole frame behind?  skip ahead, rather than rendering a burst
+        // of frames to catch up.
+        if (late >= (int32_t) frame_us) {
+            wake = xTaskGetTickCount();
+            due = start;
+        }
+        hist_add(led_stats.jitter, late);
+
+        uint32_t ticks = millis();
+        if (leds_off_request) {
+            // everything fades back up from black, from the next frame.
+            _leds_off();
+            prev_ticks = ticks;
+            continue;
+        }
+        int elapsed = ticks - prev_ticks;
+        prev_ticks = ticks;
+        bool changed = render_leds(ticks, elapsed);
+        hist_add(led_stats.render, micros() - start);
+        led_stats.frames++;
+
+        // only send the strip when it'd look different.
+        if (changed) {
+            uint32_t show_start = micros();
+            FastLED.show();
+            hist_add(led_stats.show, micros() - show_start);
+            led_stats.shows++;
+        }
+    }
+}
+
+void airportsLoop()
+{
+    _update_current_airport();
+
+    // how's the LED task doing?
+    uint32_t ticks = millis();
+    if (ticks - led_stats_start < LED_STATS_INTERVAL) return;
+    led_stats_start = ticks;
+
+    led_stats_t stats;
+    get_led_stats(stats);
+    char buf[320];
+    char *pBuf = buf, *pEnd = buf + sizeof(buf);
+    logInfo("airportsLoop: %d airports, sent %u of %u LED frames\n",
+        num_airports, stats.shows - logged_stats.shows, stats.frames - logged_stats.frames);
+    logInfo("  jitter us: %s\n", hist_str(pBuf, pEnd, stats.jitter, logged_stats.jitter));
+    pBuf = buf;
+    logInfo("  render us: %s\n", hist_str(pBuf, pEnd, stats.render, logged_stats.render));
+    pBuf = buf;
+    logInfo("  show us: %s\n", hist_str(pBuf, pEnd, stats.show, logged_stats.show));
+    logged_stats = stats;
 }
@@ -4,9 +4,6 @@
 #include <stdint.h>
 #include <time.h>
 
-// t is a float [0 - 1.0], but result is cast back to int.
-#define INT_LERP(a, b, t) (int)( (((b)-(a)) * (t)) + (a) )
-
 #define CLOUD_INVALID (-1)
 #define CLOUD_SKC (0)
 #define CLOUD_CLR (1)
@@ -31,14 +28,10 @@ struct clouds_t {
 
 #define WX_CLOUD_RECORDS (4)
 
-struct airport_t {
-  char *name;
-  char *weather;
-  char *full_name;
-  float elevation;
+// weather for one station.  this is what the METAR setters fill in.
+// the live copies are in the published wx_snapshot_t (see wx_snapshot.h)
+struct wx_t {
   uint8_t wx_cond;   // WX_COND_XXX above
-  float x;
-  float y;
   int wind_dir;
   int wind_speed;
   int wind_gust;
@@ -50,11 +43,30 @@ struct airport_t {
   float temp_c;
   float dew_c;
   char report_time[8];  // 'DDHHMMZ\0'
+  time_t obs_time;      // observation time (UTC), 0 if unknown
+  bool speci;           // special (unscheduled) report
+  uint32_t wx_flags;    // WXF_XXX, from the metar text (see wx_flags.h)
+  int16_t rvr;          // lowest runway visual range (ft), -1 if none
+  int16_t vert_vis;     // vertical visibility (ft), -1 if none
   char *metar;      // metar text string.
-  time_t last_metar; // when did we last check METAR for this airport 
-  bool lightning;   // if true, lightning is present.
-  int last_flash;    // last lightning flash, in ticks()
+  bool lightning;   // if true, lightning is present (TS, or LTG in the remarks)
   bool valid_metar; // if true, we successfully parsed the last metar.
+  bool cached;      // from the warm start cache, before we knew the time, so maybe stale
+};
+
+// freshly parsed weather, not yet attached to any airport.
+struct wx_record_t {
+  char station[8];
+  wx_t wx;
+};
+
+struct airport_t {
+  char *name;
+  char *weather;
+  char *full_name;
+  float elevation;
+  float x;
+  float y;
 };
 
 void airportsBegin();
@@ -63,9 +75,39 @@ void airportsLoop();
 #define AIRPORT_BLINK_RATE (250)
 #define AIRPORT_BLINK_TIME (5*1000)
 
+// the LEDs have their own task, so a slow GUI redraw doesn't stutter them.
+// it's above loop() on loop()'s core, and wakes on a fixed frame clock.
+#define LED_FRAME_MS (33)           // ~30hz
+#define LED_CORE (1)
+#define LED_PRIORITY (5)
+
+// histograms of how the LED task is keeping up.  bucket n counts values
+// under (LED_HIST_BASE << n) us; the last bucket gets everything else.
+#define LED_HIST_BUCKETS (12)
+#define LED_HIST_BASE (32)
+struct led_hist_t {
+    uint32_t count[LED_HIST_BUCKETS];
+    uint32_t max;           // us
+};
+
+// running totals, since the LED task started.
+struct led_stats_t {
+    uint32_t frames;
+    uint32_t shows;         // frames that changed, so were sent to the strip
+    led_hist_t jitter;      // how late each frame woke up
+    led_hist_t render;      // working out the colors, and fading
+    led_hist_t show;        // FastLED.show()
+};
+
+// a copy of the LED task's stats.  (may be torn a little; it's for logging)
+// threadsafe
+void get_led_stats(led_stats_t &stats);
+
 extern int num_airports;
 int load_airports();
 int airport_index(const char *name);
+int station_airport_index(const char *station, int len, int &iter);
+int airport_number(const airport_t *airport);
 airport_t *get_airport(const char *name);
 airport_t *get_airport(int index);
 bool show_airport(int n);
@@ -73,7 +115,7 @@ bool next_airport(char dir);
 void leds_off(void);
 void airport_blink(bool enable, int how_long = AIRPORT_BLINK_TIME);
 
-bool set_airport_kv(airport_t *airport, const char *key, const char *val);
+void commit_airport_wx(airport_t **batch, wx_record_t *records, int n, bool ok);
 
 int get_airport_brightness();
 void set_airport_brightness(int val);
@@ -0,0 +1,73 @@
+#include <Arduino.h>
+#include "arena.h"
+#include "log.h"
+
+// not threadsafe (each arena has one owner)
+void arena_init(arena_t *arena, size_t chunk_size)
+{
+    arena->head = arena->cur = NULL;
+    arena->chunk_size = chunk_size;
+    arena->used = 0;
+    arena->capacity = 0;
+}
+
+// not threadsafe
+void *arena_alloc(arena_t *arena, size_t size)
+{
+    // strings only, but keep pointers aligned anyway.
+    size = (size + 3) & ~3;
+    arena_chunk_t *c = arena->cur;
+    while (c != NULL && c->used + size > c->size) {
+        // the rest of this one is wasted until the next reset.
+        c = c->next;
+        if (c) c->used = 0;
+    }
+    if (c == NULL) {
+        size_t chunk = size > arena->chunk_size ? size : arena->chunk_size;
+        c = (arena_chunk_t*) malloc(sizeof(arena_chunk_t) + chunk);
+        if (c == NULL) {
+            logError("arena_alloc: out of memory for a %u byte chunk\n", chunk);
+            return NULL;
+        }
+        c->size = chunk;
+        c->used = 0;
+        // new chunks go after the current one, ahead of any we skipped.
+        if (arena->cur == NULL) {
+            c->next = arena->head;
+            arena->head = c;
+        } else {
+            c->next = arena->cur->next;
+            arena->cur->next = c;
+        }
+        arena->capacity += chunk;
+    }
+    arena->cur = c;
+    void *p = c->data + c->used;
+    c->used += size;
+    arena->used += size;
+    return p;
+}
+
+// not threadsafe
+char *arena_strndup(arena_t *arena, const char *s, size_t len)
+{
+    char *p = (char*) arena_alloc(arena, len + 1);
+    if (p == NULL) return NULL;
+    memcpy(p, s, len);
+    p[len] = '\0';
+    return p;
+}
+
+// not threadsafe
+char *arena_strdup(arena_t *arena, const char *s)
+{
+    return arena_strndup(arena, s, strlen(s));
+}
+
+// not threadsafe
+void arena_reset(arena_t *arena)
+{
+    arena->cur = arena->head;
+    if (arena->head) arena->head->used = 0;
+    arena->used = 0;
+}
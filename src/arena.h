@@ -0,0 +1,36 @@
+#ifndef _H_ARENA_
+#define _H_ARENA_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// bump allocator for strings that all go away at once.  memory comes in
+// chunks that are kept across arena_reset(), so once an arena has grown to
+// its high water mark it doesn't touch the heap again.  there's no
+// per-allocation free.
+struct arena_chunk_t {
+    arena_chunk_t *next;
+    size_t size;
+    size_t used;
+    char data[];
+};
+
+struct arena_t {
+    arena_chunk_t *head;
+    arena_chunk_t *cur;     // chunk we're allocating from
+    size_t chunk_size;      // size of new chunks (bigger if an allocation needs it)
+    size_t used;            // bytes handed out since the last reset
+    size_t capacity;        // bytes in all chunks
+};
+
+void arena_init(arena_t *arena, size_t chunk_size);
+
+// NULL if a new chunk was needed and there's no memory for it.
+void *arena_alloc(arena_t *arena, size_t size);
+char *arena_strndup(arena_t *arena, const char *s, size_t len);
+char *arena_strdup(arena_t *arena, const char *s);
+
+// forget everything allocated, keeping the chunks.
+void arena_reset(arena_t *arena);
+
+#endif // _H_ARENA_
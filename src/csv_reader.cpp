@@ -0,0 +1,88 @@
+#include <Arduino.h>
+#include "csv_reader.h"
+#include "log.h"
+
+CSVReader::CSVReader(Stream *_stream)
+{
+    stream = _stream;
+    start = end = 0;
+    eof = false;
+    totalBytes = 0;
+    nFields = 0;
+}
+
+// compact the buffer and pull more data from the stream.
+// returns false if nothing more could be read (EOF/timeout, or the buffer is full)
+bool CSVReader::fill()
+{
+    if (eof) return false;
+    if (start > 0) {
+        memmove(buf, buf + start, end - start);
+        end -= start;
+        start = 0;
+    }
+    // always leave room to '\0' terminate the last row.
+    int space = CSV_BUFFER_SIZE - 1 - end;
+    if (space <= 0) return false;
+
+    int want = stream->available();
+    if (want > space) want = space;
+    // nothing buffered?  block (up to the stream timeout) for at least one byte.
+    if (want <= 0) want = 1;
+
+    size_t got = stream->readBytes(buf + end, want);
+    if (got == 0) {
+        eof = true;
+        return false;
+    }
+    end += got;
+    totalBytes += got;
+    return true;
+}
+
+int CSVReader::readRow()
+{
+    int scan = 0;           // how far past 'start' we've already looked for '\n'
+    bool discard = false;   // row is too long for the buffer, skip it.
+    char *eol;
+
+    nFields = 0;
+    while (true) {
+        eol = (char*) memchr(buf + start + scan, '\n', end - start - scan);
+        if (eol != NULL) break;
+        scan = end - start;
+        if (fill()) continue;
+        if (eof) {
+            if (end == start) return -1;
+            // last row, with no trailing newline.
+            eol = buf + end;
+            break;
+        }
+        // buffer is full, and no newline in sight.
+        if (!discard) logError("CSVReader: row longer than %d bytes, discarding\n", CSV_BUFFER_SIZE);
+        discard = true;
+        start = end = scan = 0;
+    }
+
+    char *p = buf + start;
+    start = (eol - buf) + 1;
+    if (start > end) start = end;
+    if (discard) return 0;
+
+    *eol = '\0';
+    if (eol > p && eol[-1] == '\r') *--eol = '\0';
+    if (eol == p) return 0;
+
+    // split in place.
+    while (nFields < CSV_MAX_FIELDS) {
+        char *comma = (char*) memchr(p, ',', eol - p);
+        char *fend = comma ? comma : eol;
+        *fend = '\0';
+        fields[nFields] = p;
+        lens[nFields] = fend - p;
+        nFields++;
+        if (comma == NULL) break;
+        p = comma + 1;
+    }
+    return nFields;
+}
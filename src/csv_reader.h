@@ -0,0 +1,44 @@
+#ifndef _H_CSV_READER_
+#define _H_CSV_READER_
+
+#include <Arduino.h>
+
+#define CSV_BUFFER_SIZE (1024)   // longest row we can handle (METAR rows are ~400 bytes)
+#define CSV_MAX_FIELDS (64)      // ADDS returns ~44 columns
+
+// streaming, zero-copy CSV reader.
+// reads from 'stream' into a fixed buffer and splits each row in place.
+// field pointers point INTO the buffer, are '\0' terminated, and are only
+// valid until the next call to readRow().  No quoting support -- the
+// METAR csv doesn't use it.
+class CSVReader {
+public:
+    CSVReader(Stream *stream);
+
+    // read the next row.  returns the number of fields in the row,
+    // 0 for a blank (or oversized, and discarded) row, -1 on EOF/timeout.
+    int readRow();
+
+    int numFields() const { return nFields; }
+    const char *field(int n) const { return (n < 0 || n >= nFields) ? "" : fields[n]; }
+    int fieldLen(int n) const { return (n < 0 || n >= nFields) ? 0 : lens[n]; }
+
+    // total bytes pulled from the stream so far.
+    size_t bytesRead() const { return totalBytes; }
+
+private:
+    bool fill();
+
+    Stream *stream;
+    char buf[CSV_BUFFER_SIZE];
+    int start;          // start of unconsumed data in buf
+    int end;            // end of valid data in buf
+    bool eof;
+    size_t totalBytes;
+
+    int nFields;
+    const char *fields[CSV_MAX_FIELDS];
+    int lens[CSV_MAX_FIELDS];
+};
+
+#endif // _H_CSV_READER_
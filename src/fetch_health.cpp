@@ -0,0 +1,88 @@
+#include <Arduino.h>
+#include "fetch_health.h"
+#include "log.h"
+
+// only used by the refresh task.
+static int state = HEALTH_CLOSED;
+static int failures;            // in a row
+static int open_time = HEALTH_OPEN_TIME;
+static time_t next_attempt;
+static bool probing;            // HALF_OPEN request in flight
+
+static const char *state_names[] = { "CLOSED", "OPEN", "HALF_OPEN" };
+
+// somewhere in [t/2, t)
+static int jitter(int t)
+{
+    return t / 2 + (t > 1 ? esp_random() % (t / 2) : 0);
+}
+
+// not threadsafe
+bool health_allow(time_t now)
+{
+    if (now < next_attempt) return false;
+    if (state == HEALTH_OPEN) {
+        logInfo("fetch health: OPEN -> HALF_OPEN, trying one request\n");
+        state = HEALTH_HALF_OPEN;
+        probing = false;
+    }
+    if (state == HEALTH_HALF_OPEN) {
+        if (probing) return false;
+        probing = true;
+    }
+    return true;
+}
+
+// not threadsafe
+void health_result(bool ok, time_t now)
+{
+    if (ok) {
+        if (state != HEALTH_CLOSED) logInfo("fetch health: %s -> CLOSED\n", state_names[state]);
+        state = HEALTH_CLOSED;
+        failures = 0;
+        open_time = HEALTH_OPEN_TIME;
+        next_attempt = 0;
+        return;
+    }
+
+    failures++;
+    if (state == HEALTH_HALF_OPEN) {
+        // still broken.  stay away longer this time.
+        open_time *= 2;
+        if (open_time > HEALTH_OPEN_MAX) open_time = HEALTH_OPEN_MAX;
+    }
+    if (state == HEALTH_HALF_OPEN || failures >= HEALTH_TRIP_FAILURES) {
+        if (state != HEALTH_OPEN) logInfo("fetch health: %s -> OPEN for ~%d s (%d failures)\n", state_names[state], open_time, failures);
+        state = HEALTH_OPEN;
+        next_attempt = now + jitter(open_time);
+        return;
+    }
+    int backoff = HEALTH_BACKOFF_BASE << (failures - 1);
+    if (backoff > HEALTH_BACKOFF_MAX) backoff = HEALTH_BACKOFF_MAX;
+    next_attempt = now + jitter(backoff);
+    logInfo("fetch health: failure %d, retrying in %d s\n", failures, (int)(next_attempt - now));
+}
+
+// not threadsafe
+time_t health_next_attempt()
+{
+    return next_attempt;
+}
+
+// not threadsafe
+int health_state()
+{
+    return state;
+}
+
+// not threadsafe
+const char *health_state_name()
+{
+    return state_names[state];
+}
+
+// not threadsafe
+int health_failures()
+{
+    return failures;
+}
@@ -0,0 +1,39 @@
+#ifndef _H_FETCH_HEALTH_
+#define _H_FETCH_HEALTH_
+
+#include <time.h>
+
+// keeps weather fetches from hammering the server (or the radio) when
+// they're failing.
+//
+// CLOSED: requests go out.  each failure backs off exponentially (with
+//   jitter, so a room full of maps doesn't retry in step); a success resets.
+// OPEN: after HEALTH_TRIP_FAILURES failures in a row, nothing goes out for
+//   HEALTH_OPEN_TIME (doubling, up to HEALTH_OPEN_MAX, while it keeps failing).
+// HALF_OPEN: the open time is up; one request is let through to see if
+//   things are better.  success closes, failure opens again.
+
+#define HEALTH_CLOSED (0)
+#define HEALTH_OPEN (1)
+#define HEALTH_HALF_OPEN (2)
+
+#define HEALTH_BACKOFF_BASE (10)        // seconds, first retry after a failure
+#define HEALTH_BACKOFF_MAX (5*60)
+#define HEALTH_TRIP_FAILURES (5)
+#define HEALTH_OPEN_TIME (5*60)
+#define HEALTH_OPEN_MAX (30*60)
+
+// may we send a request at 'now'?
+bool health_allow(time_t now);
+
+// how the request went.
+void health_result(bool ok, time_t now);
+
+// earliest time health_allow() will say yes.
+time_t health_next_attempt();
+
+int health_state();
+const char *health_state_name();
+int health_failures();
+
+#endif // _H_FETCH_HEALTH_
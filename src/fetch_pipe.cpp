@@ -0,0 +1,149 @@
+#include <Arduino.h>
+#include "fetch_pipe.h"
+#include "log.h"
+
+static pipe_buf_t *buffers;
+static QueueHandle_t free_q;
+static QueueHandle_t full_q;
+static uint32_t producer_wait_us;
+static uint32_t consumer_wait_us;
+
+// not threadsafe (call once, before starting either side)
+bool pipe_begin()
+{
+    buffers = (pipe_buf_t*) malloc(PIPE_BUFFERS * sizeof(pipe_buf_t));
+    free_q = xQueueCreate(PIPE_BUFFERS, sizeof(pipe_buf_t*));
+    full_q = xQueueCreate(PIPE_BUFFERS, sizeof(pipe_buf_t*));
+    if (buffers == NULL || free_q == NULL || full_q == NULL) {
+        logError("pipe_begin: out of memory\n");
+        return false;
+    }
+    for (int i = 0; i < PIPE_BUFFERS; i++) {
+        pipe_buf_t *buf = buffers + i;
+        xQueueSend(free_q, &buf, 0);
+    }
+    return true;
+}
+
+pipe_buf_t *pipe_get_free()
+{
+    pipe_buf_t *buf;
+    uint32_t start = micros();
+    xQueueReceive(free_q, &buf, portMAX_DELAY);
+    producer_wait_us += micros() - start;
+    return buf;
+}
+
+void pipe_put(pipe_buf_t *buf)
+{
+    xQueueSend(full_q, &buf, portMAX_DELAY);
+}
+
+void pipe_send(uint8_t kind, void *job, bool ok)
+{
+    pipe_buf_t *buf = pipe_get_free();
+    buf->kind = kind;
+    buf->job = job;
+    buf->ok = ok;
+    buf->len = 0;
+    pipe_put(buf);
+}
+
+pipe_buf_t *pipe_get()
+{
+    pipe_buf_t *buf;
+    uint32_t start = micros();
+    xQueueReceive(full_q, &buf, portMAX_DELAY);
+    consumer_wait_us += micros() - start;
+    return buf;
+}
+
+void pipe_free(pipe_buf_t *buf)
+{
+    xQueueSend(free_q, &buf, portMAX_DELAY);
+}
+
+uint32_t pipe_producer_wait(bool reset)
+{
+    uint32_t rc = producer_wait_us;
+    if (reset) producer_wait_us = 0;
+    return rc;
+}
+
+uint32_t pipe_consumer_wait(bool reset)
+{
+    uint32_t rc = consumer_wait_us;
+    if (reset) consumer_wait_us = 0;
+    return rc;
+}
+
+PipeStream::PipeStream()
+{
+    cur = NULL;
+    pos = 0;
+    ended = false;
+    ok = false;
+}
+
+PipeStream::~PipeStream()
+{
+    finish();
+}
+
+// move on to the next buffer.  false at PIPE_END.
+bool PipeStream::next()
+{
+    if (cur) pipe_free(cur);
+    cur = NULL;
+    pos = 0;
+    if (ended) return false;
+
+    pipe_buf_t *buf = pipe_get();
+    if (buf->kind != PIPE_DATA) {
+        // PIPE_END (a PIPE_START here would mean the producer lost track)
+        ok = (buf->kind == PIPE_END && buf->ok);
+        ended = true;
+        pipe_free(buf);
+        return false;
+    }
+    cur = buf;
+    return true;
+}
+
+int PipeStream::available()
+{
+    return cur ? cur->len - pos : 0;
+}
+
+int PipeStream::read()
+{
+    char c;
+    return readBytes(&c, 1) == 1 ? (uint8_t) c : -1;
+}
+
+int PipeStream::peek()
+{
+    while (cur == NULL || pos == cur->len) {
+        if (!next()) return -1;
+    }
+    return (uint8_t) cur->data[pos];
+}
+
+// returns what's left in the current buffer, which may be less than 'length'.
+size_t PipeStream::readBytes(char *buffer, size_t length)
+{
+    while (cur == NULL || pos == cur->len) {
+        if (!next()) return 0;
+    }
+    size_t n = cur->len - pos;
+    if (n > length) n = length;
+    memcpy(buffer, cur->data + pos, n);
+    pos += n;
+    return n;
+}
+
+bool PipeStream::finish()
+{
+    while (next()) ;
+    return ok;
+}
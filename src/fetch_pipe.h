@@ -0,0 +1,68 @@
+#ifndef _H_FETCH_PIPE_
+#define _H_FETCH_PIPE_
+
+#include <Arduino.h>
+
+// a fixed ring of buffers between the network task (producer) and the parse
+// task (consumer), passed back and forth through two queues.  when the
+// parser falls behind, the producer blocks for a free buffer; when the
+// network is slow, the parser blocks for a full one.
+//
+// each response is sent as PIPE_START (with a job pointer), any number of
+// PIPE_DATA buffers, then PIPE_END (with the fetch's status).
+
+#define PIPE_BUFFERS (4)
+#define PIPE_BUFFER_SIZE (2048)
+
+#define PIPE_START (0)
+#define PIPE_DATA (1)
+#define PIPE_END (2)
+
+struct pipe_buf_t {
+    uint8_t kind;       // PIPE_XXX above
+    bool ok;            // PIPE_END: did the fetch succeed?
+    uint16_t len;       // PIPE_DATA: bytes in data
+    void *job;          // PIPE_START: whatever the consumer needs to know
+    char data[PIPE_BUFFER_SIZE];
+};
+
+bool pipe_begin();
+
+// producer side.  threadsafe (one producer)
+pipe_buf_t *pipe_get_free();
+void pipe_put(pipe_buf_t *buf);
+void pipe_send(uint8_t kind, void *job, bool ok);
+
+// consumer side.  threadsafe (one consumer)
+pipe_buf_t *pipe_get();
+void pipe_free(pipe_buf_t *buf);
+
+// time each side has spent blocked on the other since the last call, in us.
+uint32_t pipe_producer_wait(bool reset = false);
+uint32_t pipe_consumer_wait(bool reset = false);
+
+// the consumer's view of one response: the PIPE_DATA buffers, up to PIPE_END.
+class PipeStream : public Stream {
+public:
+    PipeStream();
+    ~PipeStream();
+
+    int available();
+    int read();
+    int peek();
+    size_t readBytes(char *buffer, size_t length);
+    size_t write(uint8_t) { return 0; }
+
+    // skip to PIPE_END, and return its status.
+    bool finish();
+
+private:
+    bool next();
+
+    pipe_buf_t *cur;
+    int pos;
+    bool ended;
+    bool ok;
+};
+
+#endif // _H_FETCH_PIPE_
@@ -0,0 +1,161 @@
+#include <Arduino.h>
+#include "gzip_stream.h"
+#include "log.h"
+
+// gzip header flags (RFC 1952)
+#define GZ_FHCRC    (0x02)
+#define GZ_FEXTRA   (0x04)
+#define GZ_FNAME    (0x08)
+#define GZ_FCOMMENT (0x10)
+
+GzipStream::GzipStream(Stream *_in)
+{
+    in = _in;
+    decomp = NULL;
+    window = NULL;
+    wr = rd = 0;
+    done = true;
+    in_start = in_end = 0;
+    in_eof = false;
+    total_in = 0;
+}
+
+GzipStream::~GzipStream()
+{
+    if (decomp) free(decomp);
+    if (window) free(window);
+}
+
+// pull more compressed data.  returns bytes added, 0 if none (yet).
+// if 'block', waits (up to the stream timeout) for at least one byte.
+int GzipStream::readIn(bool block)
+{
+    if (in_eof) return 0;
+    if (in_start > 0) {
+        memmove(inbuf, inbuf + in_start, in_end - in_start);
+        in_end -= in_start;
+        in_start = 0;
+    }
+    int want = in->available();
+    if (want > (int)(GZIP_INPUT_SIZE - in_end)) want = GZIP_INPUT_SIZE - in_end;
+    if (want <= 0) {
+        if (!block) return 0;
+        want = 1;
+    }
+    size_t got = in->readBytes((char*) inbuf + in_end, want);
+    if (got == 0) in_eof = true;
+    in_end += got;
+    total_in += got;
+    return got;
+}
+
+bool GzipStream::skipHeaderBytes(int n)
+{
+    while (n > 0) {
+        if (in_start == in_end && readIn(true) == 0) return false;
+        int skip = in_end - in_start;
+        if (skip > n) skip = n;
+        in_start += skip;
+        n -= skip;
+    }
+    return true;
+}
+
+bool GzipStream::skipHeaderString()
+{
+    while (true) {
+        if (in_start == in_end && readIn(true) == 0) return false;
+        if (inbuf[in_start++] == '\0') return true;
+    }
+}
+
+bool GzipStream::begin()
+{
+    while (in_end < 10) {
+        if (readIn(true) == 0) {
+            logError("GzipStream: short header\n");
+            return false;
+        }
+    }
+    if (inbuf[0] != 0x1f || inbuf[1] != 0x8b || inbuf[2] != 8) {
+        logError("GzipStream: not gzip (%02x %02x %02x)\n", inbuf[0], inbuf[1], inbuf[2]);
+        return false;
+    }
+    uint8_t flags = inbuf[3];
+    in_start = 10;
+    if (flags & GZ_FEXTRA) {
+        while (in_end - in_start < 2) if (readIn(true) == 0) return false;
+        int xlen = inbuf[in_start] | (inbuf[in_start+1] << 8);
+        in_start += 2;
+        if (!skipHeaderBytes(xlen)) return false;
+    }
+    if ((flags & GZ_FNAME) && !skipHeaderString()) return false;
+    if ((flags & GZ_FCOMMENT) && !skipHeaderString()) return false;
+    if ((flags & GZ_FHCRC) && !skipHeaderBytes(2)) return false;
+
+    decomp = (tinfl_decompressor*) malloc(sizeof(tinfl_decompressor));
+    window = (uint8_t*) malloc(TINFL_LZ_DICT_SIZE);
+    if (decomp == NULL || window == NULL) {
+        logError("GzipStream: out of memory\n");
+        return false;
+    }
+    tinfl_init(decomp);
+    done = false;
+    return true;
+}
+
+// run the inflater once.  returns false when there's no more output.
+bool GzipStream::inflate(bool block)
+{
+    if (in_start == in_end) readIn(block);
+    if (in_start == in_end && !in_eof) return true;     // nothing yet.
+
+    // the window is circular; start over once everything in it is handed out.
+    if (wr == TINFL_LZ_DICT_SIZE) wr = rd = 0;
+    size_t in_size = in_end - in_start;
+    size_t out_size = TINFL_LZ_DICT_SIZE - wr;
+    tinfl_status status = tinfl_decompress(decomp, inbuf + in_start, &in_size,
+        window, window + wr, &out_size, in_eof ? 0 : TINFL_FLAG_HAS_MORE_INPUT);
+    in_start += in_size;
+    wr += out_size;
+
+    if (status == TINFL_STATUS_DONE) {
+        // the 8 byte trailer (crc, length) is left for whoever drains 'in'.
+        done = true;
+    } else if (status < 0 || (status == TINFL_STATUS_NEEDS_MORE_INPUT && in_eof)) {
+        logError("GzipStream: inflate failed (%d)\n", status);
+        done = true;
+    }
+    return !done || rd < wr;
+}
+
+int GzipStream::available()
+{
+    if (rd == wr && !done) inflate(false);
+    return wr - rd;
+}
+
+int GzipStream::read()
+{
+    char c;
+    return readBytes(&c, 1) == 1 ? (uint8_t) c : -1;
+}
+
+int GzipStream::peek()
+{
+    if (available() == 0) return -1;
+    return window[rd];
+}
+
+// returns what's in the window, which may be less than 'length'.
+size_t GzipStream::readBytes(char *buffer, size_t length)
+{
+    while (rd == wr) {
+        if (done || !inflate(true)) return 0;
+    }
+    size_t n = wr - rd;
+    if (n > length) n = length;
+    memcpy(buffer, window + rd, n);
+    rd += n;
+    return n;
+}
@@ -0,0 +1,55 @@
+#ifndef _H_GZIP_STREAM_
+#define _H_GZIP_STREAM_
+
+#include <Arduino.h>
+
+#if CONFIG_IDF_TARGET_ESP32S3
+#include "esp32s3/rom/miniz.h"
+#else
+#include "rom/miniz.h"
+#endif
+
+#define GZIP_INPUT_SIZE (1024)
+
+// inflates a gzip stream as it's read, using the inflater in ROM.
+// deflate may refer back up to 32K, so that's how big the output window
+// is (TINFL_LZ_DICT_SIZE); it's allocated by begin() and freed with the
+// stream.  output is handed out of the window directly, nothing else is
+// buffered.
+class GzipStream : public Stream {
+public:
+    GzipStream(Stream *in);
+    ~GzipStream();
+
+    // read the gzip header, and allocate the window.  false if this isn't gzip.
+    bool begin();
+
+    int available();
+    int read();
+    int peek();
+    size_t readBytes(char *buffer, size_t length);
+    size_t write(uint8_t) { return 0; }
+
+    // compressed bytes read so far.
+    size_t bytesIn() const { return total_in; }
+
+private:
+    int readIn(bool block);
+    bool inflate(bool block);
+    bool skipHeaderBytes(int n);
+    bool skipHeaderString();
+
+    Stream *in;
+    tinfl_decompressor *decomp;
+    uint8_t *window;
+    size_t wr;              // where the inflater writes next
+    size_t rd;              // next byte to hand out (rd <= wr)
+    bool done;
+
+    uint8_t inbuf[GZIP_INPUT_SIZE];
+    size_t in_start, in_end;
+    bool in_eof;
+    size_t total_in;
+};
+
+#endif // _H_GZIP_STREAM_
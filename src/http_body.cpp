@@ -0,0 +1,92 @@
+#include <Arduino.h>
+#include "http_body.h"
+#include "log.h"
+
+HttpBodyStream::HttpBodyStream(Stream *_client, int size, bool _chunked)
+{
+    client = _client;
+    chunked = _chunked;
+    until_close = (!chunked && size < 0);
+    failed = false;
+    left = chunked ? 0 : size;
+    done = (!chunked && size == 0);
+}
+
+// read the next chunk header ("1f4;ext\r\n").  the last chunk is size 0,
+// followed by optional trailers and a blank line.
+bool HttpBodyStream::nextChunk()
+{
+    if (left == 0 && !done) {
+        String line = client->readStringUntil('\n');
+        if (line.length() == 0) {
+            failed = done = true;
+            return false;
+        }
+        left = strtol(line.c_str(), NULL, 16);
+        if (left == 0) {
+            // trailers, up to the blank line.
+            while ((line = client->readStringUntil('\n')).length() > 1) ;
+            done = true;
+            return false;
+        }
+    }
+    return !done;
+}
+
+int HttpBodyStream::available()
+{
+    if (done) return 0;
+    int avail = client->available();
+    if (!until_close && avail > left) avail = left;
+    return avail;
+}
+
+int HttpBodyStream::read()
+{
+    char c;
+    return readBytes(&c, 1) == 1 ? (uint8_t) c : -1;
+}
+
+int HttpBodyStream::peek()
+{
+    if (done) return -1;
+    if (chunked && !nextChunk()) return -1;
+    return client->peek();
+}
+
+// returns what we could get in one read, which may be short.
+size_t HttpBodyStream::readBytes(char *buffer, size_t length)
+{
+    if (done) return 0;
+    if (chunked && !nextChunk()) return 0;
+    if (!until_close && (int) length > left) length = left;
+
+    size_t got = client->readBytes(buffer, length);
+    if (got == 0) {
+        // timeout, or the server hung up.
+        if (!until_close) failed = true;
+        done = true;
+        return 0;
+    }
+    if (until_close) return got;
+
+    left -= got;
+    if (left == 0) {
+        if (chunked) {
+            // each chunk's data is followed by CRLF
+            client->readStringUntil('\n');
+        } else {
+            done = true;
+        }
+    }
+    return got;
+}
+
+bool HttpBodyStream::drain()
+{
+    char buf[128];
+    int skipped = 0;
+    while (!done) skipped += readBytes(buf, sizeof(buf));
+    if (skipped) logDebug("HttpBodyStream: drained %d bytes\n", skipped);
+    return !failed && !until_close;
+}
@@ -0,0 +1,44 @@
+#ifndef _H_HTTP_BODY_
+#define _H_HTTP_BODY_
+
+#include <Arduino.h>
+
+// the body of an HTTP response, read straight off the connection.
+// HTTPClient::getStreamPtr() hands back the raw socket: chunk headers and
+// all, and with no idea where the body ends.  that's fine for a connection
+// that closes after one response, but on a kept-alive one we have to stop
+// at the end of the body (or we block until the read times out), and leave
+// the socket at the start of the next response.
+class HttpBodyStream : public Stream {
+public:
+    // 'size' is the Content-Length, or -1 if unknown.
+    HttpBodyStream(Stream *client, int size, bool chunked);
+
+    int available();
+    int read();
+    int peek();
+    size_t readBytes(char *buffer, size_t length);
+    size_t write(uint8_t) { return 0; }
+
+    // read (and discard) whatever is left of the body.  returns true if we
+    // got to the end of it cleanly, so the connection can be reused.
+    bool drain();
+
+    // true once the whole body has been read.
+    bool complete() const { return done; }
+
+    // true if the body ended early (timeout, or the server hung up)
+    bool error() const { return failed; }
+
+private:
+    bool nextChunk();
+
+    Stream *client;
+    bool chunked;
+    bool until_close;       // no length, not chunked: body ends when the server hangs up
+    bool done;
+    bool failed;
+    int left;               // bytes left in the body (or current chunk)
+};
+
+#endif // _H_HTTP_BODY_
@@ -1,20 +1,101 @@
 #ifndef _H_KV_PAIR_
 #define _H_KV_PAIR_
 
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
 template <typename T>
 struct kv_pair {
     const char *key;
     T val;
 };
 
-template <typename T>
-static T match_kv( kv_pair<T> *kv, const char *key)
+// FNV-1a, with a seed mixed into the offset basis.  the low bits of FNV
+// only depend on the low bits of the input, so fold the high half down
+// before we mask it.
+constexpr uint32_t kv_hash(const char *key, uint32_t seed)
+{
+    uint32_t h = 2166136261u ^ seed;
+    while (*key) {
+        h ^= (uint8_t) *key++;
+        h *= 16777619u;
+    }
+    return h ^ (h >> 16);
+}
+
+// power of 2, at least twice the number of keys (so a seed turns up quickly).
+constexpr size_t kv_map_size(size_t n)
 {
-    while(kv->key != NULL) {
-        if (strcmp(key,kv->key)==0) break;
-        kv++;
+    size_t size = 1;
+    while (size < 2 * n) size <<= 1;
+    return size;
+}
+
+#define KV_MAP_MAX_SEED (1u << 16)
+#define KV_MAP_EMPTY (0xff)
+
+// not constexpr, so calling it stops the compile: there's no seed below
+// KV_MAP_MAX_SEED that gives every key its own slot.
+void kv_map_no_perfect_hash();
+
+template <typename T> struct kv_identity { typedef T type; };
+
+// a fixed table of keys, with a perfect hash worked out at compile time:
+// a lookup is one hash and one strcmp().  declare it constexpr, so a bad
+// table is a compile error, and the whole thing ends up in flash:
+//
+//   static constexpr kv_pair<int> colors_kv[] = { { "RED", 1 }, { "BLUE", 2 } };
+//   static constexpr kv_map colors(colors_kv, -1);
+//   int c = match_kv(colors, "BLUE");
+//
+// unlike a kv_pair list, the pairs don't end with { NULL, missing }.
+template <typename T, size_t N>
+class kv_map {
+public:
+    static constexpr size_t SIZE = kv_map_size(N);
+    static_assert(N < KV_MAP_EMPTY, "kv_map: too many keys");
+
+    constexpr kv_map(const kv_pair<T> (&kv)[N], typename kv_identity<T>::type missing)
+        : kv(kv), missing(missing), seed(0), slots{}
+    {
+        for (; seed < KV_MAP_MAX_SEED; seed++) {
+            if (place()) return;
+        }
+        kv_map_no_perfect_hash();
+    }
+
+    // threadsafe
+    T match(const char *key) const
+    {
+        uint8_t i = slots[kv_hash(key, seed) & (SIZE - 1)];
+        if (i == KV_MAP_EMPTY || strcmp(key, kv[i].key) != 0) return missing;
+        return kv[i].val;
+    }
+
+private:
+    // try the current seed.
+    constexpr bool place()
+    {
+        for (size_t s = 0; s < SIZE; s++) slots[s] = KV_MAP_EMPTY;
+        for (size_t i = 0; i < N; i++) {
+            uint8_t &slot = slots[kv_hash(kv[i].key, seed) & (SIZE - 1)];
+            if (slot != KV_MAP_EMPTY) return false;
+            slot = i;
+        }
+        return true;
     }
-    return kv->val;
+
+    const kv_pair<T> *kv;
+    T missing;
+    uint32_t seed;
+    uint8_t slots[SIZE];
+};
+
+template <typename T, size_t N>
+static T match_kv(const kv_map<T, N> &map, const char *key)
+{
+    return map.match(key);
 }
 
-#endif // _H_KV_PAIR_
\ No newline at end of file
+#endif // _H_KV_PAIR_
@@ -0,0 +1,169 @@
+#include <Arduino.h>
+#include "led_anim.h"
+#include "log.h"
+
+#define KEYS(k) k, sizeof(k) / sizeof(k[0])
+
+static const anim_key_t pulse_keys[] = { { 0, 0 }, { 1000, 160 }, { 2000, 0 } };
+static const anim_key_t strobe_keys[] = { { 0, 255 }, { 50, 255 }, { 50, 0 }, { 1000, 0 } };
+static const anim_key_t blink_keys[] = { { 0, 255 }, { 250, 255 }, { 250, 0 }, { 500, 0 } };
+static const anim_key_t lightning_keys[] = {
+    { 0, 255 }, { 60, 0 }, { 110, 255 }, { 170, 64 }, { 230, 200 }, { 400, 0 },
+};
+static const anim_key_t gust_keys[] = { { 0, 0 }, { 150, 48 }, { 250, 8 }, { 400, 40 }, { 600, 0 } };
+static const anim_key_t crossfade_keys[] = { { 0, 255 }, { 500, 0 } };
+
+// indexed by ANIM_XXX
+static const anim_def_t anim_defs[ANIM_EFFECTS] = {
+    { NULL, 0, 0, 0, 0 },                                   // ANIM_NONE
+    { KEYS(pulse_keys), ANIM_LOOP, 0, 0 },                  // ANIM_PULSE
+    { KEYS(strobe_keys), ANIM_LOOP, 0, 0 },                 // ANIM_STROBE
+    { KEYS(blink_keys), ANIM_LOOP, 0, 0 },                  // ANIM_BLINK
+    { KEYS(lightning_keys), ANIM_LOOP | ANIM_RANDOM_PHASE, 1000, 3000 },   // ANIM_LIGHTNING
+    { KEYS(gust_keys), ANIM_LOOP | ANIM_RANDOM_PHASE, 0, 1200 },           // ANIM_GUST
+    { KEYS(crossfade_keys), 0, 0, 0 },                      // ANIM_CROSSFADE
+};
+
+// a running effect.
+struct anim_t {
+    uint16_t led;
+    uint8_t effect;         // ANIM_XXX
+    uint8_t key;            // keyframe we're past
+    uint16_t time;          // ms into the effect (gap included)
+    uint16_t gap;           // this time around
+    CRGB color;
+    uint8_t mix;            // last frame's
+};
+
+static anim_t *pool;        // running effects are pool[0 .. num_anims]
+static int num_anims;
+static int16_t *slot;       // led -> pool index, -1 if none
+static int num_leds;
+static bool stopped;        // something stopped since the last frame
+
+static uint16_t anim_length(const anim_def_t &def)
+{
+    return def.keys[def.num_keys - 1].time;
+}
+
+static uint16_t anim_gap(const anim_def_t &def)
+{
+    return def.gap_max > def.gap_min ? random(def.gap_min, def.gap_max) : def.gap_min;
+}
+
+// not threadsafe
+bool anim_begin(int leds)
+{
+    pool = (anim_t*) calloc(leds, sizeof(anim_t));
+    slot = (int16_t*) malloc(leds * sizeof(int16_t));
+    if (pool == NULL || slot == NULL) {
+        logError("anim_begin: out of memory for %d LEDs\n", leds);
+        free(pool);
+        free(slot);
+        pool = NULL;
+        slot = NULL;
+        return false;
+    }
+    for (int i = 0; i < leds; i++) slot[i] = -1;
+    num_leds = leds;
+    num_anims = 0;
+    return true;
+}
+
+// not threadsafe
+int anim_effect(int led)
+{
+    if (led < 0 || led >= num_leds || slot[led] < 0) return ANIM_NONE;
+    return pool[slot[led]].effect;
+}
+
+// not threadsafe
+void anim_start(int led, int effect, const CRGB &color)
+{
+    if (led < 0 || led >= num_leds || effect <= ANIM_NONE || effect >= ANIM_EFFECTS) return;
+    if (anim_effect(led) == effect) return;
+    if (slot[led] < 0) slot[led] = num_anims++;
+
+    const anim_def_t &def = anim_defs[effect];
+    anim_t *a = pool + slot[led];
+    a->led = led;
+    a->effect = effect;
+    a->key = 0;
+    a->gap = anim_gap(def);
+    a->time = (def.flags & ANIM_RANDOM_PHASE) ? random(0, anim_length(def) + a->gap) : 0;
+    a->color = color;
+    a->mix = 0;
+    // the first frame always counts as a change.
+    stopped = true;
+}
+
+// not threadsafe
+void anim_stop(int led)
+{
+    if (led < 0 || led >= num_leds || slot[led] < 0) return;
+    // move the last one into the hole.
+    int n = slot[led];
+    pool[n] = pool[--num_anims];
+    slot[pool[n].led] = n;
+    slot[led] = -1;
+    stopped = true;
+}
+
+// not threadsafe
+int anim_count()
+{
+    return num_anims;
+}
+
+// (mix + 1), so 255 gets all the way there.  0 is skipped.
+static inline uint8_t blend8(uint8_t from, uint8_t to, uint8_t mix)
+{
+    return from + (((to - from) * (mix + 1)) >> 8);
+}
+
+// not threadsafe
+bool anim_frame(CRGB *leds, int elapsed)
+{
+    bool changed = stopped;
+    for (int n = 0; n < num_anims; n++) {
+        anim_t *a = pool + n;
+        const anim_def_t &def = anim_defs[a->effect];
+        uint16_t length = anim_length(def);
+
+        uint32_t time = a->time + elapsed;
+        if (time >= (uint32_t) length + a->gap) {
+            if (!(def.flags & ANIM_LOOP)) {
+                // done; what's now in pool[n] hasn't been done yet.
+                anim_stop(a->led);
+                changed = true;
+                n--;
+                continue;
+            }
+            time = (time - length - a->gap) % length;
+            a->key = 0;
+            a->gap = anim_gap(def);
+        }
+        a->time = time;
+
+        // where are we between keyframes?  (in a gap, we hold the last one)
+        const anim_key_t *keys = def.keys;
+        while (a->key + 1 < def.num_keys && keys[a->key + 1].time <= time) a->key++;
+        uint8_t mix;
+        if (a->key + 1 >= def.num_keys) {
+            mix = keys[a->key].mix;
+        } else {
+            const anim_key_t &k0 = keys[a->key], &k1 = keys[a->key + 1];
+            mix = k0.mix + (int)(k1.mix - k0.mix) * (int)(time - k0.time) / (k1.time - k0.time);
+        }
+        if (mix != a->mix) changed = true;
+        a->mix = mix;
+        if (mix == 0) continue;
+
+        CRGB &led = leds[a->led];
+        led.r = blend8(led.r, a->color.r, mix);
+        led.g = blend8(led.g, a->color.g, mix);
+        led.b = blend8(led.b, a->color.b, mix);
+    }
+    stopped = false;
+    return changed;
+}
@@ -0,0 +1,54 @@
+#ifndef _H_LED_ANIM_
+#define _H_LED_ANIM_
+
+#include <FastLED.h>
+
+// LED effects, as keyframes.  each LED can have one effect running; an
+// effect blends the LED from whatever color it would otherwise be toward
+// the effect's color, by the keyframes' 'mix' (0: not at all, 255: all
+// the way), interpolated in between.  all the running effects are done
+// in one pass per frame, out of a pool allocated by anim_begin().
+
+#define ANIM_NONE (0)
+#define ANIM_PULSE (1)          // slow breathe
+#define ANIM_STROBE (2)         // short flash, once a second
+#define ANIM_BLINK (3)          // square wave (the cursor)
+#define ANIM_LIGHTNING (4)      // a burst of flashes, then 1-3 seconds dark
+#define ANIM_GUST (5)           // faint flicker
+#define ANIM_CROSSFADE (6)      // from the color to the LED's own, once
+#define ANIM_EFFECTS (7)
+
+struct anim_key_t {
+    uint16_t time;          // ms from the start of the effect
+    uint8_t mix;
+};
+
+// flags
+#define ANIM_LOOP (0x01)            // start again at the end, after a gap (ms) in [gap_min, gap_max)
+#define ANIM_RANDOM_PHASE (0x02)    // start somewhere random, so neighbors don't move together
+
+struct anim_def_t {
+    const anim_key_t *keys;
+    uint8_t num_keys;
+    uint8_t flags;
+    uint16_t gap_min, gap_max;
+};
+
+// not threadsafe (LED task only, from here on)
+bool anim_begin(int num_leds);
+
+// start 'effect' on 'led', replacing what's there.  does nothing if it's
+// already running (so it can be called every frame).
+void anim_start(int led, int effect, const CRGB &color);
+void anim_stop(int led);
+int anim_effect(int led);
+
+// advance the effects by 'elapsed' ms, and blend them into 'leds', which
+// should hold the colors without effects.  true if the result is any
+// different from the last frame's.
+bool anim_frame(CRGB *leds, int elapsed);
+
+// running effects.
+int anim_count();
+
+#endif // _H_LED_ANIM_
@@ -0,0 +1,16 @@
+#include "led_fade.h"
+
+// a flat loop over bytes with no branches (the ?: is a select), so the
+// compiler is free to vectorize it.
+// threadsafe
+int fade_toward(uint8_t *cur, const uint8_t *target, int n, int rate)
+{
+    int moved = 0;
+    for (int i = 0; i < n; i++) {
+        int c = cur[i];
+        int next = fade_step(c, target[i], rate);
+        moved += (next != c);
+        cur[i] = next;
+    }
+    return moved;
+}
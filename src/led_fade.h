@@ -0,0 +1,26 @@
+#ifndef _H_LED_FADE_
+#define _H_LED_FADE_
+
+#include <stdint.h>
+
+// integer fading, for the LED loop.  'rate' is the fraction of the way to
+// the target to move each frame, in 256ths.  steps are rounded away from
+// zero, so a fade always lands exactly on its target (and then stops).
+
+#define FADE_RATE_LEDS (51)         // 0.2 per frame
+#define FADE_RATE_BRIGHTNESS (26)   // 0.1 per frame
+
+// one step of 'cur' toward 'target'.
+// threadsafe
+static inline int fade_step(int cur, int target, int rate)
+{
+    int d = target - cur;
+    return cur + ((d * rate + (d > 0 ? 255 : 0)) >> 8);
+}
+
+// fade 'n' bytes (3 per CRGB) of 'cur' toward 'target'.  returns how many
+// moved; 0 means everything is already where it's going.
+// threadsafe
+int fade_toward(uint8_t *cur, const uint8_t *target, int n, int rate);
+
+#endif // _H_LED_FADE_
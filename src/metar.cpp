@@ -1,162 +1,405 @@
 #include <Arduino.h>
-#include <HTTPClient.h>
 #include "metar.h"
+#include "metar_parse.h"
 #include "log.h"
-#include "msgbox.h"
+#include "csv_reader.h"
+#include "gzip_stream.h"
+#include "wx_source.h"
+#include "fetch_pipe.h"
+#include "fetch_health.h"
+#include "wx_schedule.h"
+#include "wx_snapshot.h"
 
-static const String metarUrl = "https://www.aviationweather.gov/adds/dataserver_current/httpparam?"
-    "dataSource=metars&requestType=retrieve&hoursBeforeNow=6&mostRecentForEachStation=true&format=csv"
-    "&stationString=";
+metar_stats_t metar_stats;
 
-bool update_airport_wx(airport_t **airports)
+// where the weather comes from (WX_SOURCE)
+static WeatherSource *source;
+
+// one batch, from the network task to the parse task.
+struct metar_job_t {
+    airport_t **batch;      // NULL terminated
+    int count;
+    bool filtering;         // response has stations that aren't ours (bulk)
+    bool has_body;
+    bool gzip;
+    bool json;              // JSON API response, rather than CSV
+};
+
+// batch size tuning.  batches grow by METAR_BATCH_STEP while full ones come
+// back quickly, halve when one fails, and shrink when they get slow or heap
+// gets tight.  a size that failed isn't tried again until we've had
+// METAR_BATCH_SETTLE good requests since.
+// only used by the refresh task.
+static int batch_size = METAR_BATCH_START;
+static int batch_ceiling = MAX_AIRPORT_UPDATES;
+static int batch_good;
+static char batch_why[96] = "initial size";
+
+// network time and bytes for the last fetch_wx()
+static uint32_t last_request_ms;
+static uint32_t last_request_bytes;
+
+// jobs sent to the parse task that it hasn't finished yet.  it sends back
+// one result per job (did the response arrive, and parse), in order.
+static int pending;
+static QueueHandle_t job_results;
+static uint32_t cycle_start;
+
+// copy the body into the pipe, a buffer at a time.
+// not threadsafe (network task only)
+static void send_body(Stream *body)
 {
-    HTTPClient http;
-    airport_t *airport;
-    airport_t **a;
-    String url = metarUrl;
+    bool eof = false;
+    while (!eof) {
+        pipe_buf_t *buf = pipe_get_free();
+        buf->kind = PIPE_DATA;
+        buf->len = 0;
+        while (buf->len < PIPE_BUFFER_SIZE) {
+            int want = body->available();
+            if (want <= 0) want = 1;
+            if (want > PIPE_BUFFER_SIZE - buf->len) want = PIPE_BUFFER_SIZE - buf->len;
+            size_t got = body->readBytes(buf->data + buf->len, want);
+            if (got == 0) {
+                eof = true;
+                break;
+            }
+            buf->len += got;
+        }
+        metar_stats.bytes += buf->len;
+        if (buf->len > 0) pipe_put(buf);
+        else pipe_free(buf);
+    }
+}
+
+// take the result of the oldest job, and tell fetch_health how that request
+// went.  a response only counts as good once it's parsed: a server sending
+// us garbage is as broken as one not answering.  false if it isn't done
+// within 'ticks'.
+// not threadsafe (refresh task only)
+static bool take_result(TickType_t ticks)
+{
+    bool ok;
+    if (xQueueReceive(job_results, &ok, ticks) != pdTRUE) return false;
+    pending--;
     time_t now;
     time(&now);
-    bool first=true;
-    for (a = airports; *a; a++) {
-        airport = *a;
-        const char *weather = (airport->weather ? airport->weather : airport->name);
-        if (!first) url += ",";
-        url += weather;
-        first = false;
-
-        // we set last metar fetch time, so we don't keep trying if it fails.
-        // see comments in airports.c about why we do this!
-        airport->last_metar = now;
-        airport->cloud_idx = 0;
-        airport->valid_metar = false;
-        set_airport_metar(airport, "data unavailable");
+    health_result(ok, now);
+    return true;
+}
+
+// ask the source for 'stations' (NULL for all of them), and hand the
+// response to the parse task as 'job'.  returns false if the request failed;
+// whether the response parsed comes later, through take_result().
+// not threadsafe (network task only)
+static bool fetch_wx(const String *stations, int hours, metar_job_t *job)
+{
+    // job_results only holds METAR_MAX_PENDING results, so with that many
+    // outstanding, wait for the oldest one to be done before sending another.
+    if (pending >= METAR_MAX_PENDING) take_result(portMAX_DELAY);
+
+    uint32_t fetch_start = micros();
+    uint32_t request_start = millis();
+    uint32_t waited = pipe_producer_wait();
+    uint32_t bytes_start = metar_stats.bytes;
+
+    wx_response_t resp;
+    Stream *body = source->open(stations, hours, resp);
+    bool ok = (resp.status != WX_RESPONSE_FAILED);
+    job->has_body = (body != NULL);
+    job->gzip = resp.gzip;
+    job->json = resp.json;
+    job->filtering = resp.filtered;
+
+    if (pending++ == 0) cycle_start = millis();
+    pipe_send(PIPE_START, job, true);
+    if (body != NULL) {
+        send_body(body);
+        ok = source->close();
     }
+    pipe_send(PIPE_END, NULL, ok);
 
-    http.begin(url.c_str());
+    metar_stats.receive_us += (micros() - fetch_start) - (pipe_producer_wait() - waited);
+    // what the source took, not counting waiting for the parser.
+    last_request_ms = (millis() - request_start) - (pipe_producer_wait() - waited) / 1000;
+    last_request_bytes = metar_stats.bytes - bytes_start;
 
-    logInfo("Fetching %s\n",url.c_str());
-    int rc = http.GET();
-    if (rc <= 0) {
-        http.end();
-        logError("HTTP GET %s: ERROR: %d %s\n", url.c_str(), rc, http.errorToString(rc).c_str() );
-        showMessagef(5000,"Error fetching METAR: %s", http.errorToString(rc)); 
-        http.end();
-        return false;
+    // anything that's finished by now counts before the next health_allow().
+    while (pending > 0 && take_result(0)) ;
+    return ok;
+}
+
+// parse one response body into 'staged'.
+// not threadsafe (parse task only)
+static bool parse_body(Stream &in, const metar_job_t *job, int &num_staged)
+{
+    // inflated as the parser reads it.
+    GzipStream gz(&in);
+    Stream *body = &in;
+    if (job->gzip) {
+        if (!gz.begin()) return false;
+        body = &gz;
     }
-    logDebug("HTTP GET %s: rc=%d size=%d\n", url.c_str(), rc, http.getSize());
-    auto stream = http.getStreamPtr();
-    if (stream == NULL) {
-        logError("HTTP Get: failed to get stream pointer?\n");
-        http.end();
-        showMessage(5000, "Error fetching METAR: failed to get stream");
-        return false;
+
+    bool ok;
+    if (job->json) {
+        CountingStream counted(body);
+        ok = parse_wx_json(counted, num_staged, job->filtering);
+        metar_stats.inflated += counted.bytesRead();
+    } else {
+        CSVReader csv(body);
+        ok = parse_wx(csv, num_staged, job->filtering);
+        metar_stats.inflated += csv.bytesRead();
     }
-    // now read the stream...
-    // first line should be "No warnings"
-    String tmp;
-    int num_results = 0;
+    return ok;
+}
+
+// second half of the pipeline: parse what the network task sends us, and
+// commit it.  pinned to the same core as the network task, leaving the other
+// one to LVGL and the LEDs.
+static void parse_task(void *params)
+{
+    logInfo("parse_task begin\n");
     while (true) {
-        tmp = stream->readStringUntil('\n');
-        // logDebug("HTTP GET: READ: %s\n",tmp.c_str());
-        if (tmp == "") {
-            logError("HTTP GET: incomplete results\n");
-            set_airport_metar(airport, "Error fetching METAR: incomplete results");
-            http.end();
-            return false;
-        }
-        if (tmp.endsWith(" results")) {
-            num_results = atoi(tmp.c_str());
-            if (num_results == 0) {
-                logError("HTTP GET: No results returned\n");
-                http.end();
-                return false;
-            }
-            break;
+        pipe_buf_t *buf = pipe_get();
+        if (buf->kind != PIPE_START) {
+            logError("parse_task: expected a new job, got %d\n", buf->kind);
+            pipe_free(buf);
+            continue;
         }
+        metar_job_t *job = (metar_job_t*) buf->job;
+        pipe_free(buf);
+
+        uint32_t start = micros();
+        uint32_t waited = pipe_consumer_wait();
+        int num_staged = 0;
+        wx_record_t *staged = reserve_staged(job->filtering ? num_airports : job->count);
+        bool parsed = (staged != NULL);
+        PipeStream in;
+        if (parsed && job->has_body) parsed = parse_body(in, job, num_staged);
+        bool received = in.finish();
+        bool ok = received && parsed;
+        if (received && !parsed) logError("METAR: response didn't parse\n");
+        // commit even on failure: whatever did parse is good, and old
+        // reports still need to age out.
+        commit_airport_wx(job->batch, staged, num_staged, ok);
+        free(job);
+
+        metar_stats.parse_us += (micros() - start) - (pipe_consumer_wait() - waited);
+        // the refresh task hands this to fetch_health.
+        xQueueSend(job_results, &ok, portMAX_DELAY);
     }
+}
 
-    String keyStr = stream->readStringUntil('\n');
-    int kLen = keyStr.length();
-    int kStart = 0, kEnd;
-    int cols = 0;
-    // first, count columns.
-    // logDebug("Counting columns\n");
-    while (kStart < kLen) {
-        cols++;
-        kEnd = keyStr.indexOf(',',kStart);
-        if (kEnd == -1) kEnd = kLen;
-        kStart = kEnd + 1;
+// a copy of the NULL terminated 'batch', for the parse task (which frees it).
+static metar_job_t *new_job(airport_t **batch)
+{
+    int count = 0;
+    while (batch[count]) count++;
+    metar_job_t *job = (metar_job_t*) malloc(sizeof(metar_job_t) + (count + 1) * sizeof(airport_t*));
+    if (job == NULL) {
+        logError("METAR: out of memory for a %d airport job\n", count);
+        return NULL;
     }
-    // logDebug("%d columns\n", cols);
-
-    // now allocate holders for keys and values.
-    String keys[cols];
-    String vals[cols];
-
-    // now split keys
-    kStart = 0; 
-    int col = 0;
-    // logDebug("Splitting keys\n");
-    while (kStart < kLen) {
-        kEnd = keyStr.indexOf(',',kStart);
-        if (kEnd == -1) kEnd = kLen;
-        keys[col] = keyStr.substring(kStart,kEnd);
-        // logDebug("Col %d: %s\n", col, keys[col].c_str());
-        col++;
-        kStart = kEnd + 1;
+    job->batch = (airport_t**)(job + 1);
+    memcpy(job->batch, batch, (count + 1) * sizeof(airport_t*));
+    job->count = count;
+    job->filtering = false;
+    job->has_body = false;
+    job->gzip = false;
+    job->json = false;
+    return job;
+}
+
+// pick the next batch size from how the last batch of 'count' stations went.
+// 'stations_len' is the length of its station list.
+// not threadsafe (refresh task only)
+static void tune_batch(int count, bool ok, int stations_len)
+{
+    int size = batch_size;
+    uint32_t ms = last_request_ms;
+    uint32_t per_station = last_request_bytes / (count ? count : 1);
+    size_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    const char *why;
+
+    if (!ok) {
+        // too big (a timeout), or the server's having trouble; either way, back off.
+        batch_ceiling = count - METAR_BATCH_STEP;
+        batch_good = 0;
+        size = count / 2;
+        why = "failed";
+    } else if (largest < METAR_BATCH_HEAP_LOW) {
+        size = size * 3 / 4;
+        why = "low heap";
+    } else if (ms > METAR_BATCH_SLOW_MS) {
+        size = size * 3 / 4;
+        why = "slow";
+    } else {
+        if (++batch_good >= METAR_BATCH_SETTLE && batch_ceiling < MAX_AIRPORT_UPDATES) {
+            batch_ceiling += METAR_BATCH_STEP;
+            batch_good = 0;
+        }
+        // grow if this was a full batch, and a bigger one should still be quick.
+        uint32_t projected = ms * (size + METAR_BATCH_STEP) / (count ? count : 1);
+        if (count >= size && projected < METAR_BATCH_SLOW_MS / 2 && size + METAR_BATCH_STEP <= batch_ceiling) {
+            size += METAR_BATCH_STEP;
+            why = "fast";
+        } else {
+            why = "holding";
+        }
     }
 
-    // find 'station' column...
-    int station_col = -1;
-    for(auto i = 0; i < cols; i++) {
-        if (keys[i] == "station_id") {
-            station_col = i;
-            break;
+    // the station list has to fit in the URL, at this batch's chars/station.
+    int max_len = source->maxStationsLength();
+    if (max_len > 0 && stations_len > 0) {
+        int url_cap = max_len * count / stations_len;
+        if (size > url_cap) {
+            size = url_cap;
+            why = "URL length";
         }
     }
-    if (station_col == -1) {
-        logError("No 'station_id' column returned in results?\n");
-        return false;
+    if (size > MAX_AIRPORT_UPDATES) size = MAX_AIRPORT_UPDATES;
+    if (size < METAR_BATCH_MIN) size = METAR_BATCH_MIN;
+
+    snprintf(batch_why, sizeof(batch_why), "%s: %u ms for %d, %u bytes/station, %u KB heap block",
+        why, ms, count, per_station, (unsigned)(largest / 1024));
+    if (size != batch_size) logInfo("METAR: batch size %d -> %d (%s)\n", batch_size, size, batch_why);
+    batch_size = size;
+}
+
+// not threadsafe (refresh task only)
+int metar_batch_size()
+{
+    return batch_size;
+}
+
+// fetch weather for a NULL terminated list of (at most metar_batch_size())
+// airports.  the response is parsed and committed by the parse task, while
+// we get on with the next request; metar_wait() waits for it to catch up.
+// we only ask for reports since the oldest one we already have for the batch
+// (in whole hours, so the URL -- and its validators -- stay the same for a
+// while); stations that don't show up had nothing newer.
+// not threadsafe (refresh task only)
+bool update_airport_wx(airport_t **airports)
+{
+    airport_t *airport;
+    airport_t **a;
+    time_t now;
+    time(&now);
+
+    time_t oldest = now;
+    String stations;
+    for (a = airports; *a; a++) {
+        airport = *a;
+        const char *weather = (airport->weather ? airport->weather : airport->name);
+        if (a != airports) stations += ",";
+        stations += weather;
+        // (the parse task only updates airports from earlier batches)
+        time_t obs = schedule_obs_time(airport_number(airport));
+        if (obs == 0) obs = now - METAR_MAX_AGE;
+        if (obs < oldest) oldest = obs;
     }
-    // logDebug("station_id column = %d\n", station_col);
-
-    // logDebug("Processing results\n");
-    int n = 0;
-    while (n++ < num_results) {
-        String valStr = stream->readStringUntil('\n');
-        // logDebug("RESULT %d: '%s'\n", n, valStr.c_str());
-        int vLen = valStr.length();
-        int vStart = 0, vEnd;
-        col = 0;
-        while (vStart < vLen) {
-            vEnd = valStr.indexOf(',',vStart);
-            if (vEnd == -1) vEnd = vLen;
-            vals[col++] = valStr.substring(vStart,vEnd);
-            vStart = vEnd + 1;
-        }
+    int hours = (now - oldest + 3599) / 3600;
+    if (hours < 1) hours = 1;
+    if (hours > METAR_MAX_AGE / 3600) hours = METAR_MAX_AGE / 3600;
 
-        const char *station = vals[station_col].c_str();
-
-        // logDebug("Looking for station %s\n", station);
-        for(a = airports; *a; a++) {
-            airport = *a;
-            const char *weather = (airport->weather ? airport->weather : airport->name);
-            if (strcmp(weather,station)==0) {
-                logDebug("found %s: (%s)\n", weather, airport->full_name);
-                for (auto i = 0; i < cols; i++) {
-                    const char *k = keys[i].c_str();
-                    const char *v = vals[i].c_str();
-                    // logInfo("update_airport_wx[%d]: K: %s  V: %s\n", i, k, v);
-                    set_airport_kv(airport,k,v);
-                }
-                airport->valid_metar = true;
-                break;
-            }
-        }
-        if (*a == NULL) {
-            logError("Didn't find airport for station_id '%s'\n", station);
-        }
+    metar_job_t *job = new_job(airports);
+    if (job == NULL) return false;
+    bool ok = fetch_wx(&stations, hours, job);
+    tune_batch(a - airports, ok, stations.length());
+    return ok;
+}
+
+// fetch weather for every airport.  from the API, that's its file of all
+// current METARs: one (big, but gzipped) request rather than one per batch,
+// streamed through the parser; rows for stations that aren't on the map are
+// dropped after a hash lookup.
+// not threadsafe (refresh task only)
+bool update_all_airport_wx()
+{
+    static airport_t **all;
+    if (all == NULL) {
+        all = (airport_t**) malloc((num_airports + 1) * sizeof(airport_t*));
+        if (all == NULL) return false;
+        for (int i = 0; i < num_airports; i++) all[i] = get_airport(i);
+        all[num_airports] = NULL;
     }
-    http.end();
+
+    metar_job_t *job = new_job(all);
+    if (job == NULL) return false;
+    return fetch_wx(NULL, METAR_MAX_AGE / 3600, job);
+}
+
+// should we ask for everything at once?
+// not threadsafe (refresh task only)
+bool metar_bulk_mode()
+{
+    return source->bulkOnly() || num_airports > METAR_BULK_THRESHOLD;
+}
+
+// does the weather source need wifi?
+// not threadsafe (refresh task only)
+bool metar_needs_network()
+{
+    return source->needsNetwork();
+}
+
+// wait for the parse task to finish everything we've sent it.
+// not threadsafe (refresh task only)
+void metar_wait()
+{
+    if (pending == 0) return;
+    while (pending > 0) take_result(portMAX_DELAY);
+    metar_stats.cycle_ms += millis() - cycle_start;
+}
+
+// not threadsafe (call once, from setup)
+bool metarBegin()
+{
+    source = wx_source_create();
+    logInfo("metarBegin: weather from %s\n", source->name());
+    job_results = xQueueCreate(METAR_MAX_PENDING, sizeof(bool));
+    if (job_results == NULL || !pipe_begin()) {
+        logError("metarBegin: failed to set up the pipeline\n");
+        return false;
+    }
+    TaskHandle_t handle;
+    BaseType_t rc = xTaskCreatePinnedToCore(parse_task, "parse",
+            8192,       // stack size
+            NULL,       // parameters
+            tskIDLE_PRIORITY,  // prio
+            &handle,
+            METAR_CORE);
+    if (rc != pdPASS) {
+        logError("metarBegin: failed to start parse_task\n");
+        return false;
+    }
+    logInfo("metarBegin: created parse task\n");
     return true;
+}
+
+// not threadsafe (refresh task only)
+void metar_stats_report()
+{
+    logInfo("METAR: %u requests (%u not modified), %u connects (%u ms), %u ms in requests\n",
+        metar_stats.requests, metar_stats.not_modified, metar_stats.connects, metar_stats.connect_ms, metar_stats.request_ms);
+    logInfo("METAR: %u bytes (%u uncompressed), %u rows: %u applied, %u unchanged, %u not ours\n",
+        metar_stats.bytes, metar_stats.inflated, metar_stats.rows, metar_stats.applied, metar_stats.unchanged, metar_stats.filtered);
+    if (!metar_bulk_mode()) {
+        logInfo("METAR: batch size %d (%s), %u KB heap low water\n",
+            batch_size, batch_why, esp_get_minimum_free_heap_size() / 1024);
+    }
+    logInfo("METAR: fetch health %s, %d failures in a row\n", health_state_name(), health_failures());
+    // for watching fragmentation over a long run.
+    size_t free_heap = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    size_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    size_t text_used, text_capacity;
+    wx_text_stats(text_used, text_capacity);
+    logInfo("METAR: heap %u KB free, largest block %u KB (%u%% fragmented); METAR text %u of %u KB\n",
+        free_heap / 1024, largest / 1024, free_heap ? 100 - largest * 100 / free_heap : 0,
+        text_used / 1024, text_capacity / 1024);
+    uint32_t cycle = metar_stats.cycle_ms ? metar_stats.cycle_ms : 1;
+    logInfo("METAR: %u ms start to finish; receive busy %u ms (%u%%), parse busy %u ms (%u%%)\n",
+        metar_stats.cycle_ms, metar_stats.receive_us / 1000, metar_stats.receive_us / 10 / cycle,
+        metar_stats.parse_us / 1000, metar_stats.parse_us / 10 / cycle);
+    memset(&metar_stats, 0, sizeof(metar_stats));
 }
\ No newline at end of file
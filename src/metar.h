@@ -3,7 +3,74 @@
 
 #include "airports.h"
 
+// most airports we'll ever ask for in one request.  the batch size is
+// tuned at runtime (see metar_batch_size()), between METAR_BATCH_MIN and this.
+#define MAX_AIRPORT_UPDATES (128)
+
+#define METAR_BATCH_START (32)
+#define METAR_BATCH_MIN (4)
+#define METAR_BATCH_STEP (4)
+#define METAR_BATCH_SETTLE (10)             // good requests before retrying a size that failed
+#define METAR_BATCH_SLOW_MS (8000)          // requests that take longer than this are too big
+#define METAR_BATCH_HEAP_LOW (40*1024)      // shrink if the largest free block is under this (TLS needs ~40K)
+#define METAR_URL_MAX (2000)                // longest URL we'll send (HTTP source)
+
+// the network and parse tasks run here; LVGL and the LEDs have the other
+// core (ARDUINO_RUNNING_CORE)
+#define METAR_CORE (0)
+
+// most batches the network task can get ahead of the parse task; past
+// this, fetch_wx() waits for the oldest to finish before sending another.
+#define METAR_MAX_PENDING (64)
+
+// maps with more airports than this fetch everything from the server's
+// bulk file, instead of asking for stations a batch at a time.
+#ifndef METAR_BULK_THRESHOLD
+#define METAR_BULK_THRESHOLD (100)
+#endif
+
+// reports older than this are dropped (and never asked for).
+#define METAR_MAX_AGE (6*3600)
+
+// one station of a JSON response, after the filter (mostly the raw METAR
+// text, and a few cloud layers)
+#define METAR_JSON_DOC_SIZE (1536)
+#define METAR_JSON_FILTER_SIZE (512)
+
+// what the fetches cost, since the last metar_stats_report()
+struct metar_stats_t {
+    uint32_t requests;
+    uint32_t not_modified;  // 304 responses
+    uint32_t connects;      // new connections (TCP + TLS handshake)
+    uint32_t connect_ms;    // time spent connecting
+    uint32_t request_ms;    // time from sending a request to the end of the response
+    uint32_t bytes;         // response bytes read, as sent
+    uint32_t inflated;      // ... and after decompression
+    uint32_t rows;          // data rows in the responses
+    uint32_t applied;       // rows parsed into new weather
+    uint32_t unchanged;     // rows skipped, same observation we already have (or older)
+    uint32_t filtered;      // rows for stations not on the map
+    uint32_t cycle_ms;      // first request sent -> last batch committed
+    uint32_t receive_us;    // network task busy (not waiting for buffers)
+    uint32_t parse_us;      // parse task busy (not waiting for data)
+};
+
+extern metar_stats_t metar_stats;
+
+bool metarBegin();
+bool metar_bulk_mode();
+bool metar_needs_network();
+
+// these hand the response to the parse task, and return once it has been
+// received.  metar_wait() waits for everything to be committed.
 bool update_airport_wx(airport_t **airports);
-void set_airport_metar(airport_t *airport, const char *val);
+bool update_all_airport_wx();
+void metar_wait();
+
+// how many airports to put in the next update_airport_wx() batch.
+int metar_batch_size();
+
+// log the stats, and reset them.
+void metar_stats_report();
 
-#endif // _H_METAR_H_
\ No newline at end of file
+#endif // _H_METAR_H_
@@ -0,0 +1,375 @@
+#include <Arduino.h>
+#include "metar_fields.h"
+#include "csv_reader.h"
+#include "wx_flags.h"
+#include "arena.h"
+#include "log.h"
+
+// METAR text of the records being parsed, until commit_airport_wx() copies
+// it into the snapshot.  reset after every commit.
+#define STAGED_TEXT_CHUNK (4096)
+static arena_t staged_text;
+
+// not threadsafe
+void metar_fields_begin()
+{
+    arena_init(&staged_text, STAGED_TEXT_CHUNK);
+}
+
+// not threadsafe (parse task only)
+void staged_text_reset()
+{
+    arena_reset(&staged_text);
+}
+
+// not threadsafe
+static bool set_int(int &out, const char *val, int len, int def_val)
+{
+    if (len == 0) { out = def_val; return true; }
+    out = atoi(val);
+    return true;
+}
+
+// not threadsafe
+static bool set_float(float &out, const char *val, int len, float def_val)
+{
+    if (len == 0) { 
+        logDebug("set_float: returning default (%f)\n", def_val);
+        out = def_val; 
+        return true; 
+    }
+    out = strtof(val,NULL);
+    logDebug("set_float: '%s' parses to %f\n", val, out );
+    return true;
+}
+
+// a copy of 'val' (or 'def_val' if it's empty) in the staging arena.
+// not threadsafe (parse task only)
+static bool set_charbuf(char *&out, const char *val, int len, const char *def_val)
+{
+    out = NULL;
+    if (val == NULL || len == 0) {
+        val = def_val;
+        len = val ? strlen(val) : 0;
+    }
+    if (val != NULL) out = arena_strndup(&staged_text, val, len);
+    return true;
+}
+
+// 0 is variable; the JSON API says "VRB", which atoi() also makes 0.
+// not threadsafe
+static bool set_wind_dir(wx_t *wx, int arg, const char *val, int len)
+{
+    return set_int(wx->wind_dir, val, len, -1);
+}
+
+// not threadsafe
+static bool set_wind_speed(wx_t *wx, int arg, const char *val, int len)
+{
+    return set_int(wx->wind_speed, val, len, -1);
+}
+
+// not threadsafe
+static bool set_wind_gust(wx_t *wx, int arg, const char *val, int len)
+{
+    return set_int(wx->wind_gust, val, len, -1);
+}
+
+// not threadsafe
+static bool set_vis(wx_t *wx, int arg, const char *val, int len)
+{
+    return set_float(wx->vis, val, len, -1.0);
+}
+
+// not threadsafe
+static bool set_altimiter(wx_t *wx, int arg, const char *val, int len)
+{
+    return set_float(wx->altimiter, val, len, -1.0);
+}
+
+#define INHG_PER_HPA (0.0295300)
+
+// the JSON API has the altimiter in hPa.  we keep inches.
+// not threadsafe
+static bool set_altimiter_hpa(wx_t *wx, int arg, const char *val, int len)
+{
+    float hpa;
+    set_float(hpa, val, len, -1.0);
+    wx->altimiter = hpa < 0 ? -1.0 : hpa * INHG_PER_HPA;
+    return true;
+}
+
+/* in a METAR, this is station elevation, which we don't really care about. 
+static bool set_elevation(wx_t *wx, int arg, const char *val, int len)
+{
+    return set_float(wx->elevation, val, len, 0);
+}
+*/
+
+static constexpr kv_pair<int> sky_cover_kv[] = {
+    { "SKC", CLOUD_SKC },
+    { "CLR", CLOUD_CLR },
+    { "CAVOK", CLOUD_CAVOK },
+    { "FEW", CLOUD_FEW },
+    { "SCT", CLOUD_SCT },
+    { "BKN", CLOUD_BKN },
+    { "OVC", CLOUD_OVC },
+    { "OVX", CLOUD_OVX },
+};
+static constexpr kv_map sky_cover_map(sky_cover_kv, CLOUD_INVALID);
+
+// the columns 'sky_cover' and 'cloud_base_ft_agl' appear several times in the
+// CSV file we get from the METAR.  build_metar_plan() numbers them as they appear,
+// and passes the cloud slot as 'arg', so the order of the columns doesn't matter.
+// apply_metar_row() clears the clouds before each row.
+// cloud_idx is the number of layers with valid cover.
+// not threadsafe
+static bool set_sky_cover(wx_t *wx, int arg, const char *val, int len)
+{
+    logDebug("sky_cover[%d] = %s\n", arg, val);
+    clouds_t *c = wx->clouds + arg;
+    c->sky_cover = match_kv( sky_cover_map, val );
+    if (c->sky_cover != CLOUD_INVALID && wx->cloud_idx <= arg) wx->cloud_idx = arg + 1;
+    return true;
+}
+
+// not threadsafe
+static bool set_cloud_base(wx_t *wx, int arg, const char *val, int len)
+{
+    logDebug("cloud_base_ft_agl[%d] = %s\n", arg, val);
+    return set_int(wx->clouds[arg].altitude, val, len, -1);
+}
+
+// not threadsafe
+static bool set_temp(wx_t *wx, int arg, const char *val, int len)
+{
+    return set_float(wx->temp_c, val, len, -999 );
+}
+
+// not threadsafe
+static bool set_dew(wx_t *wx, int arg, const char *val, int len)
+{
+    return set_float(wx->dew_c, val, len, -999 );
+}
+
+// days since 1970-01-01 for a UTC civil date, without going through the TZ
+// (newlib has no timegm()).  http://howardhinnant.github.io/date_algorithms.html
+static time_t utc_time(int y, int m, int d, int hh, int mm, int ss)
+{
+    y -= m <= 2;
+    int era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = (unsigned)(y - era * 400);
+    unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    long days = era * 146097L + (long) doe - 719468L;
+    return (time_t) days * 86400 + hh * 3600 + mm * 60 + ss;
+}
+
+// observation_time, i.e. 2023-03-18T23:47:00Z.  returns 0 if it doesn't parse.
+// threadsafe
+time_t parse_obs_time(const char *val)
+{
+    int y, m, d, hh, mm, ss;
+    if (sscanf(val, "%d-%d-%dT%d:%d:%d", &y, &m, &d, &hh, &mm, &ss) != 6) return 0;
+    return utc_time(y, m, d, hh, mm, ss);
+}
+
+// obs_time, and report_time from it.
+// not threadsafe
+static bool set_obs(wx_t *wx, time_t obs_time)
+{
+    wx->report_time[0] = '\0';
+    wx->obs_time = obs_time;
+    if (wx->obs_time == 0) return false;
+    struct tm tm;
+    gmtime_r(&wx->obs_time, &tm);
+    snprintf(wx->report_time, sizeof(wx->report_time), "%02d%02d%02dZ", tm.tm_mday, tm.tm_hour, tm.tm_min);
+    return true;
+}
+
+// observation_time.  also fills in report_time.
+// not threadsafe
+static bool set_report_time(wx_t *wx, int arg, const char *val, int len)
+{
+    return set_obs(wx, parse_obs_time(val));
+}
+
+// obsTime, from the JSON API: seconds since the epoch.
+// not threadsafe
+static bool set_obs_epoch(wx_t *wx, int arg, const char *val, int len)
+{
+    return set_obs(wx, len ? (time_t) atol(val) : 0);
+}
+
+// METAR or SPECI
+// not threadsafe
+static bool set_metar_type(wx_t *wx, int arg, const char *val, int len)
+{
+    wx->speci = (strcmp(val, "SPECI") == 0);
+    return true;
+}
+
+// the text, and what scan_metar() finds in it.
+// not threadsafe
+static bool set_metar(wx_t *wx, int arg, const char *val, int len)
+{
+    scan_metar(wx, val, len);
+    return set_charbuf(wx->metar, val, len, "");
+}
+
+static constexpr kv_pair<int> flight_category_kv[] = {
+    { "VFR",  WX_COND_VFR },
+    { "MVFR", WX_COND_MVFR },
+    { "IFR",  WX_COND_IFR },
+    { "LIFR", WX_COND_LIFR },
+};
+static constexpr kv_map flight_category_map(flight_category_kv, -1);
+
+// not threadsafe
+static bool set_flight_category(wx_t *wx, int arg, const char *val, int len)
+{
+    logInfo("Set flight category = %s\n", val);
+    int cond = match_kv(flight_category_map, val);
+    // empty (not reported), or something we don't know.  deal with it
+    // here, once per report, as VFR, so nothing downstream sees an out of
+    // range wx_cond.
+    if (cond < 0) {
+        if (len > 0) logError("Invalid flight category '%s', using VFR\n", val);
+        cond = WX_COND_VFR;
+    }
+    wx->wx_cond = cond;
+    return true;
+}
+
+  /*
+  float press_alt;
+  time_t lastMetar; // when did we last check METAR for this airport
+  bool lightning;   // if true, lightning is present.
+  int lastFlash;    // last lightning flash, in ticks()
+  */
+static constexpr kv_pair<field_setter> metar_fields_kv[] = {
+    { "raw_text", set_metar },
+    // { "station_id", ... },
+    { "observation_time", set_report_time }, // V: 2023-03-18T23:47:00Z
+    // {"latitude", set_latitude }, //  V: 37.33
+    // {"longitude", set_longitude }, //  V: -121.82
+    {"temp_c", set_temp },                  //  V: 21.0
+    {"dewpoint_c", set_dew },               //  V: 6.0
+    {"wind_dir_degrees", set_wind_dir },    //  V: 160
+    {"wind_speed_kt", set_wind_speed },     //  V: 12
+    {"wind_gust_kt", set_wind_gust },       //  V:
+    {"visibility_statute_mi", set_vis },    //  V: 10.0
+    {"altim_in_hg", set_altimiter },        //  V: 29.940945
+    // {"sea_level_pressure_mb", ... }      //  V:
+    // {"corrected", ... },                 //  V:
+    // {"auto", ... },                      //  V:
+    // {"auto_station", ... },              //  V:
+    // {"maintenance_indicator_on", ... },  //  V:
+    // {"no_signal", ... },                 //  V:
+    // {"lightning_sensor_off", ... },      //  V:
+    // {"freezing_rain_sensor_off", ... },  //  V:
+    // {"present_weather_sensor_off", ... },//  V:
+    // {"wx_string", ... },                 //  V: 
+    {"sky_cover", set_sky_cover },          //  V: OVC (repeated, see build_metar_plan)
+    {"cloud_base_ft_agl", set_cloud_base }, //  V: 15000 (repeated)
+    {"flight_category", set_flight_category },  // V: VFR
+    // {"three_hr_pressure_tendency_mb", ... }, //  V:
+    // {"maxT_c", ... },                //  V:
+    // {"minT_c", ... },                //  V:
+    // {"maxT24hr_c", ... },            //  V:
+    // {"minT24hr_c", ... },            //  V:
+    // {"precip_in", ... },             //  V:
+    // {"pcp3hr_in", ... },             //  V:
+    // {"pcp6hr_in", ... },             //  V:
+    // {"pcp24hr_in", ... },            //  V:
+    // {"snow_in", ... },               //  V:
+    // {"vert_vis_ft", ... },           // V:
+    {"metar_type", set_metar_type },    //  V: METAR
+    // {"elevation_m", set_elevation },           // V: 37.0 (station elevation -- we don't care)
+};
+static constexpr kv_map metar_fields(metar_fields_kv, NULL);
+
+// the same, for the JSON API (api/data/metar?format=json).  each station is
+// an object; "icaoId" is the station, and "clouds" is an array of layers
+// (see metar_json_cloud_fields).  missing and null values are passed to the
+// setter as "", same as an empty CSV column.  anything not in these tables
+// is dropped by the deserialization filter, before it takes any memory.
+kv_pair<field_setter> metar_json_fields[] = {
+    {"rawOb", set_metar },              // V: KSJC 182347Z 16012KT 10SM ...
+    {"obsTime", set_obs_epoch },        // V: 1679183220
+    {"temp", set_temp },                // V: 21
+    {"dewp", set_dew },                 // V: 6
+    {"wdir", set_wind_dir },            // V: 160, or "VRB"
+    {"wspd", set_wind_speed },          // V: 12
+    {"wgst", set_wind_gust },           // V: null
+    {"visib", set_vis },                // V: "10+", or 2.5
+    {"altim", set_altimiter_hpa },      // V: 1013.9
+    {"fltCat", set_flight_category },   // V: VFR
+    {"metarType", set_metar_type },     // V: METAR
+    { NULL, NULL }
+};
+
+// one element of "clouds"; 'arg' is its index in the array.
+kv_pair<field_setter> metar_json_cloud_fields[] = {
+    {"cover", set_sky_cover },          // V: OVC
+    {"base", set_cloud_base },          // V: 15000
+    { NULL, NULL }
+};
+
+// compile the header row into a list of (column, setter) ops.  this is the
+// only place we compare column names; unknown columns don't make it into
+// the plan, so they cost nothing per row.
+// threadsafe
+bool build_metar_plan(metar_plan_t &plan, const char *const *keys, int cols)
+{
+    int sky_slot = 0, base_slot = 0;
+
+    plan.num_ops = 0;
+    plan.station_col = -1;
+    plan.obs_col = -1;
+    for (int i = 0; i < cols && i < METAR_PLAN_MAX_COLUMNS; i++) {
+        if (strcmp(keys[i], "station_id") == 0) {
+            plan.station_col = i;
+            continue;
+        }
+        field_setter handler = match_kv(metar_fields, keys[i]);
+        if (handler == NULL) continue;
+        if (handler == set_report_time) plan.obs_col = i;
+
+        int arg = 0;
+        if (handler == set_sky_cover) arg = sky_slot++;
+        else if (handler == set_cloud_base) arg = base_slot++;
+        // more cloud layers than we have room for.
+        if (arg >= WX_CLOUD_RECORDS) continue;
+
+        metar_op_t *op = plan.ops + plan.num_ops++;
+        op->col = i;
+        op->arg = arg;
+        op->setter = handler;
+    }
+    logDebug("build_metar_plan: %d columns, %d ops, station_id is column %d\n", cols, plan.num_ops, plan.station_col);
+    return plan.station_col != -1;
+}
+
+// no cloud layers, before the setters fill them in.
+// not threadsafe (wx must not be visible to anyone else yet)
+void clear_wx_clouds(wx_t *wx)
+{
+    wx->cloud_idx = 0;
+    for (int i = 0; i < WX_CLOUD_RECORDS; i++) {
+        wx->clouds[i].sky_cover = CLOUD_INVALID;
+        wx->clouds[i].altitude = -1;
+    }
+}
+
+// run one row through a plan, into a staging record.
+// not threadsafe (wx must not be visible to anyone else yet)
+void apply_metar_row(wx_t *wx, const metar_plan_t &plan, CSVReader &row)
+{
+    clear_wx_clouds(wx);
+    for (int i = 0; i < plan.num_ops; i++) {
+        const metar_op_t *op = plan.ops + i;
+        if (op->col >= row.numFields()) continue;
+        op->setter(wx, op->arg, row.field(op->col), row.fieldLen(op->col));
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef _H_METAR_FIELDS_
+#define _H_METAR_FIELDS_
+
+#include "airports.h"
+#include "kv_pair.h"
+
+// the METAR setters: each one takes one field of a report (a CSV column,
+// or a JSON API value) into a wx_t.  the METAR text itself is copied into
+// the staging arena, until commit_airport_wx() moves it into the snapshot.
+
+// values are (ptr,len) views into the CSV reader's buffer; they are '\0' terminated,
+// but only valid for the duration of the call.  'arg' comes from the plan
+// (i.e. which cloud layer)
+typedef bool (*field_setter)(wx_t *wx, int arg, const char *val, int len);
+
+#define METAR_PLAN_MAX_COLUMNS (64)
+
+struct metar_op_t {
+    uint8_t col;            // column in the row
+    int8_t arg;             // passed to setter
+    field_setter setter;
+};
+
+// header row of a METAR response, compiled once, then used for every row.
+struct metar_plan_t {
+    int station_col;
+    int obs_col;            // observation_time, -1 if not present
+    int num_ops;
+    metar_op_t ops[METAR_PLAN_MAX_COLUMNS];
+};
+
+// not threadsafe (call once, before the parse task starts)
+void metar_fields_begin();
+
+class CSVReader;
+bool build_metar_plan(metar_plan_t &plan, const char *const *keys, int cols);
+void apply_metar_row(wx_t *wx, const metar_plan_t &plan, CSVReader &row);
+void clear_wx_clouds(wx_t *wx);
+time_t parse_obs_time(const char *val);
+
+// JSON API keys -> setters
+extern kv_pair<field_setter> metar_json_fields[];
+extern kv_pair<field_setter> metar_json_cloud_fields[];
+
+// forget the staged METAR text, once it's been committed.
+// not threadsafe (parse task only)
+void staged_text_reset();
+
+#endif // _H_METAR_FIELDS_
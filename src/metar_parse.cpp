@@ -0,0 +1,265 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "metar_parse.h"
+#include "metar_fields.h"
+#include "metar.h"
+#include "log.h"
+#include "csv_reader.h"
+#include "wx_schedule.h"
+
+// weather is parsed into here with no locks held, then committed to the
+// airports in one go.  only used by the parse task.  one record per
+// airport in the batch (or on the map, in bulk mode).
+static wx_record_t *staged;
+static int max_staged;
+
+// the record each airport's station was staged in, by airport index.  only
+// good if that record is one of this parse's and has the same station, so
+// it's never cleared.  (with &hours=N, the server sends every report in the
+// window: each station can come back more than once)
+static int *staged_slot;
+
+// not threadsafe (parse task only)
+wx_record_t *reserve_staged(int n)
+{
+    if (staged_slot == NULL) {
+        staged_slot = (int*) calloc(num_airports, sizeof(int));
+        if (staged_slot == NULL) {
+            logError("METAR: can't allocate %d staging slots\n", num_airports);
+            return NULL;
+        }
+    }
+    if (n <= max_staged) return staged;
+    wx_record_t *p = (wx_record_t*) realloc(staged, n * sizeof(wx_record_t));
+    if (p == NULL) {
+        logError("METAR: can't allocate %d staging records\n", n);
+        return NULL;
+    }
+    staged = p;
+    max_staged = n;
+    return staged;
+}
+
+// a cleared staging record for 'station', or NULL if it isn't on the map,
+// or its report ('obs_time', 0 if unknown) is no newer than the one we
+// already have.  checked before any of the setters run.  a station that's already
+// been staged keeps its newest report: a newer one reuses the record, an
+// older one (or one with no time; the server lists the newest first) is skipped.
+// not threadsafe (parse task only)
+static wx_record_t *stage_station(const char *station, int len, time_t obs_time, int &num_staged, bool filtering)
+{
+    metar_stats.rows++;
+    int iter = -1;
+    int index = station_airport_index(station, len, iter);
+    if (index == -1) {
+        if (!filtering) logError("Didn't find airport for station_id '%s'\n", station);
+        metar_stats.filtered++;
+        return NULL;
+    }
+    if (obs_time != 0 && obs_time <= schedule_obs_time(index)) {
+        metar_stats.unchanged++;
+        return NULL;
+    }
+    wx_record_t *rec;
+    int slot = staged_slot[index];
+    if (slot < num_staged && strcmp(staged[slot].station, station) == 0) {
+        rec = staged + slot;
+        if (obs_time <= rec->wx.obs_time) {
+            metar_stats.unchanged++;
+            return NULL;
+        }
+    } else {
+        if (num_staged >= max_staged) {
+            logError("Too many results, ignoring station_id '%s'\n", station);
+            return NULL;
+        }
+        staged_slot[index] = num_staged;
+        rec = staged + num_staged++;
+        strncpy(rec->station, station, sizeof(rec->station) - 1);
+        rec->station[sizeof(rec->station) - 1] = '\0';
+    }
+    memset(&rec->wx, 0, sizeof(rec->wx));
+    metar_stats.applied++;
+    return rec;
+}
+
+// parse a METAR CSV response into 'staged'.  if 'filtering', the response
+// has stations we don't care about (bulk mode), and those are quietly skipped.
+// not threadsafe (parse task only), but doesn't touch any shared state.
+bool parse_wx(CSVReader &csv, int &num_staged, bool filtering)
+{
+    // first lines are a preamble ("No errors", "No warnings", ...),
+    // ending with "NNN results", then the header row.  no count means
+    // read to the end.
+    uint32_t parse_start = millis();
+    int num_results = -1;
+    int cols;
+    while (true) {
+        int nf = csv.readRow();
+        // logDebug("HTTP GET: READ: %s\n",csv.field(0));
+        if (nf <= 0) {
+            logError("HTTP GET: incomplete results\n");
+            return false;
+        }
+        if (nf > 1 && strcmp(csv.field(0), "raw_text") == 0) {
+            cols = nf;
+            break;
+        }
+        const char *line = csv.field(0);
+        int len = csv.fieldLen(0);
+        if (nf == 1 && len > 8 && strcmp(line + len - 8, " results") == 0) {
+            num_results = atoi(line);
+            // we only ask for reports newer than what we have, so no results is
+            // a perfectly good answer.
+            if (num_results == 0) {
+                logInfo("METAR: no new reports\n");
+                return true;
+            }
+            cols = csv.readRow();
+            break;
+        }
+    }
+
+    // header row.  compile it into a plan, so rows don't need to look at
+    // column names.
+    if (cols <= 0) {
+        logError("HTTP GET: missing column names\n");
+        return false;
+    }
+    const char *keys[CSV_MAX_FIELDS];
+    for (auto i = 0; i < cols; i++) keys[i] = csv.field(i);
+
+    static metar_plan_t plan;
+    if (!build_metar_plan(plan, keys, cols)) {
+        logError("No 'station_id' column returned in results?\n");
+        return false;
+    }
+    int station_col = plan.station_col;
+
+    // logDebug("Processing results\n");
+    int n = 0;
+    while (num_results < 0 || n < num_results) {
+        int nf = csv.readRow();
+        if (nf < 0) {
+            if (num_results > 0) logError("HTTP GET: incomplete results (%d of %d)\n", n, num_results);
+            break;
+        }
+        n++;
+        if (nf <= station_col) continue;
+
+        // logDebug("Looking for station %s\n", station);
+        time_t obs_time = plan.obs_col < 0 ? 0 : parse_obs_time(csv.field(plan.obs_col));
+        wx_record_t *rec = stage_station(csv.field(station_col), csv.fieldLen(station_col), obs_time, num_staged, filtering);
+        if (rec == NULL) continue;
+        apply_metar_row(&rec->wx, plan, csv);
+        rec->wx.valid_metar = true;
+    }
+    logInfo("METAR: parsed %d rows, %d bytes in %d ms\n", n, csv.bytesRead(), millis() - parse_start);
+    return true;
+}
+
+// the deserialization filter: the station, the keys in metar_json_fields,
+// and the keys in metar_json_cloud_fields for each cloud layer.
+static void build_json_filter(JsonDocument &filter)
+{
+    filter["icaoId"] = true;
+    for (kv_pair<field_setter> *f = metar_json_fields; f->key; f++) filter[f->key] = true;
+    for (kv_pair<field_setter> *f = metar_json_cloud_fields; f->key; f++) filter["clouds"][0][f->key] = true;
+}
+
+// a JSON value as the text a setter expects: strings as they are, numbers
+// as they're written, null (or missing) as "".
+static const char *json_text(JsonVariantConst v, char *buf, size_t size, int &len)
+{
+    if (v.isNull()) {
+        len = 0;
+        return "";
+    }
+    if (v.is<const char*>()) {
+        const char *s = v.as<const char*>();
+        len = strlen(s);
+        return s;
+    }
+    len = serializeJson(v, buf, size);
+    return buf;
+}
+
+// run one station object through the JSON field tables.
+// not threadsafe (wx must not be visible to anyone else yet)
+static void apply_metar_json(wx_t *wx, JsonObjectConst obj)
+{
+    char buf[32];
+    int len;
+
+    clear_wx_clouds(wx);
+    for (kv_pair<field_setter> *f = metar_json_fields; f->key; f++) {
+        const char *val = json_text(obj[f->key], buf, sizeof(buf), len);
+        f->val(wx, 0, val, len);
+    }
+    int layer = 0;
+    for (JsonObjectConst cloud : obj["clouds"].as<JsonArrayConst>()) {
+        if (layer >= WX_CLOUD_RECORDS) break;
+        for (kv_pair<field_setter> *f = metar_json_cloud_fields; f->key; f++) {
+            const char *val = json_text(cloud[f->key], buf, sizeof(buf), len);
+            f->val(wx, layer, val, len);
+        }
+        layer++;
+    }
+}
+
+// the next character that isn't whitespace, left in the stream.
+static int skip_space(Stream &in)
+{
+    int c;
+    while ((c = in.peek()) == ' ' || c == '\n' || c == '\r' || c == '\t') in.read();
+    return c;
+}
+
+// parse a JSON API response (an array of station objects) into 'staged'.
+// stations are deserialized one at a time, through the filter, into the same
+// small document, and applied as each one completes; the whole response is
+// never in memory, however many stations we asked for.
+// not threadsafe (parse task only), but doesn't touch any shared state.
+bool parse_wx_json(CountingStream &in, int &num_staged, bool filtering)
+{
+    uint32_t parse_start = millis();
+    static StaticJsonDocument<METAR_JSON_FILTER_SIZE> filter;
+    if (filter.isNull()) build_json_filter(filter);
+    DynamicJsonDocument doc(METAR_JSON_DOC_SIZE);
+
+    if (skip_space(in) != '[') {
+        logError("HTTP GET: JSON response isn't an array\n");
+        return false;
+    }
+    in.read();
+    int n = 0;
+    int c = skip_space(in);
+    while (c != ']') {
+        DeserializationError err = deserializeJson(doc, in, DeserializationOption::Filter(filter));
+        if (err) {
+            logError("HTTP GET: JSON error after %d stations: %s\n", n, err.c_str());
+            return false;
+        }
+        n++;
+
+        JsonObjectConst obj = doc.as<JsonObjectConst>();
+        const char *station = obj["icaoId"] | "";
+        wx_record_t *rec = stage_station(station, strlen(station), obj["obsTime"].as<long>(), num_staged, filtering);
+        if (rec != NULL) {
+            apply_metar_json(&rec->wx, obj);
+            rec->wx.valid_metar = true;
+        }
+
+        c = skip_space(in);
+        if (c == ',') {
+            in.read();
+            c = skip_space(in);
+        } else if (c != ']') {
+            logError("HTTP GET: incomplete JSON results (%d stations)\n", n);
+            return false;
+        }
+    }
+    if (n == 0) logInfo("METAR: no new reports\n");
+    logInfo("METAR: parsed %d stations, %d bytes in %d ms\n", n, in.bytesRead(), millis() - parse_start);
+    return true;
+}
@@ -0,0 +1,52 @@
+#ifndef _H_METAR_PARSE_
+#define _H_METAR_PARSE_
+
+#include <Arduino.h>
+#include "airports.h"
+
+// the parse task's half of a fetch: a response body (CSV or JSON, already
+// inflated) into staging records, one per station that has a newer report
+// than we do.  no locks are held; commit_airport_wx() takes the records
+// from here.
+
+class CSVReader;
+
+// counts what's read through it, for metar_stats.inflated.
+class CountingStream : public Stream {
+public:
+    CountingStream(Stream *_in) : in(_in), count(0) {}
+    int available() { return in->available(); }
+    int peek() { return in->peek(); }
+    int read()
+    {
+        int c = in->read();
+        if (c >= 0) count++;
+        return c;
+    }
+    size_t readBytes(char *buffer, size_t length)
+    {
+        size_t n = in->readBytes(buffer, length);
+        count += n;
+        return n;
+    }
+    size_t write(uint8_t) { return 0; }
+
+    size_t bytesRead() const { return count; }
+
+private:
+    Stream *in;
+    size_t count;
+};
+
+// room for 'n' staging records.  NULL if there's no memory for them.
+// not threadsafe (parse task only)
+wx_record_t *reserve_staged(int n);
+
+// parse a response into the records from reserve_staged(), counting them in
+// 'num_staged'.  if 'filtering', the response has stations we don't care
+// about (bulk mode), and those are quietly skipped.  false if it didn't parse.
+// not threadsafe (parse task only)
+bool parse_wx(CSVReader &csv, int &num_staged, bool filtering);
+bool parse_wx_json(CountingStream &in, int &num_staged, bool filtering);
+
+#endif // _H_METAR_PARSE_
@@ -14,20 +14,37 @@ static StaticSemaphore_t mutex_buffer;
 static SemaphoreHandle_t mutex = xSemaphoreCreateMutexStatic(&mutex_buffer);
 #endif // MULTI_TASK
 
+// how long the (outermost) lock is held.  only touched while holding the lock.
+static int lock_depth = 0;
+static uint32_t lock_taken_us = 0;
+static uint32_t lock_max_hold_us = 0;
+
 static inline bool _lock(TickType_t ticks = portMAX_DELAY)
 {
 #if MULTI_TASK
-    return xSemaphoreTakeRecursive(mutex, ticks) ? true : false;
-#else
-    return true;
+    if (!xSemaphoreTakeRecursive(mutex, ticks)) return false;
 #endif
+    if (lock_depth++ == 0) lock_taken_us = micros();
+    return true;
 }
 
 static inline void _release()
 {
+    if (--lock_depth == 0) {
+        uint32_t held = micros() - lock_taken_us;
+        if (held > lock_max_hold_us) lock_max_hold_us = held;
+    }
 #if MULTI_TASK
     xSemaphoreGiveRecursive(mutex);
 #endif
 }
 
+// longest time anyone has held this compilation unit's lock, in microseconds.
+static inline uint32_t _lock_max_hold(bool reset = false)
+{
+    uint32_t rc = lock_max_hold_us;
+    if (reset) lock_max_hold_us = 0;
+    return rc;
+}
+
 #endif // _H_MUTEX_
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include <Arduino.h>
+#include "station_index.h"
+#include "log.h"
+
+// FNV-1a.  station ids are 3-4 characters, nothing fancy needed.
+static uint32_t station_hash(const char *key, int len)
+{
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < len; i++) {
+        h ^= (uint8_t) key[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// capacity is the number of keys that will be added.  the table is kept
+// at most half full so probe chains stay short.
+bool station_index_init(station_index_t &idx, int capacity)
+{
+    int size = 16;
+    while (size < capacity * 2) size <<= 1;
+    idx.slots = (station_slot_t*) malloc(size * sizeof(station_slot_t));
+    if (idx.slots == NULL) {
+        logError("station_index_init: failed to allocate %d slots\n", size);
+        idx.mask = -1;
+        idx.count = 0;
+        return false;
+    }
+    for (int i = 0; i < size; i++) {
+        idx.slots[i].key = NULL;
+        idx.slots[i].hash = 0;
+        idx.slots[i].value = -1;
+    }
+    idx.mask = size - 1;
+    idx.count = 0;
+    return true;
+}
+
+void station_index_free(station_index_t &idx)
+{
+    if (idx.slots) free(idx.slots);
+    idx.slots = NULL;
+    idx.mask = -1;
+    idx.count = 0;
+}
+
+bool station_index_add(station_index_t &idx, const char *key, int value)
+{
+    if (idx.slots == NULL || (idx.count + 1) * 2 > idx.mask + 1) {
+        logError("station_index_add: index full, can't add %s\n", key);
+        return false;
+    }
+    uint32_t h = station_hash(key, strlen(key));
+    int slot = h & idx.mask;
+    while (idx.slots[slot].value != -1) slot = (slot + 1) & idx.mask;
+    idx.slots[slot].key = key;
+    idx.slots[slot].hash = (uint16_t) h;
+    idx.slots[slot].value = value;
+    idx.count++;
+    return true;
+}
+
+// 'key' doesn't need to be '\0' terminated.  set 'iter' to -1 for the first
+// call; it's updated so the next call returns the next match.
+// returns -1 when there are no (more) matches.
+int station_index_find(const station_index_t &idx, const char *key, int len, int &iter)
+{
+    if (idx.slots == NULL) return -1;
+    uint32_t h = station_hash(key, len);
+    int slot = (iter < 0) ? (int)(h & idx.mask) : ((iter + 1) & idx.mask);
+    for (; idx.slots[slot].value != -1; slot = (slot + 1) & idx.mask) {
+        const station_slot_t *s = idx.slots + slot;
+        if (s->hash != (uint16_t) h) continue;
+        if (strncmp(s->key, key, len) != 0 || s->key[len] != '\0') continue;
+        iter = slot;
+        return s->value;
+    }
+    return -1;
+}
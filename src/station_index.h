@@ -0,0 +1,31 @@
+#ifndef _H_STATION_INDEX_
+#define _H_STATION_INDEX_
+
+#include <stdint.h>
+
+// compact open-addressing hash from station id (ICAO code) to airport index.
+// duplicate keys are allowed -- several airports can take their weather
+// from the same station -- so lookups are iterators:
+//
+//     int iter = -1, i;
+//     while ((i = station_index_find(idx, key, len, iter)) != -1) { ... }
+//
+// keys are not copied; they must live as long as the index does.
+struct station_slot_t {
+    const char *key;
+    uint16_t hash;      // low bits of the key hash, checked before strncmp
+    int16_t value;      // -1 == empty
+};
+
+struct station_index_t {
+    int mask;           // table size - 1 (table size is a power of 2)
+    int count;
+    station_slot_t *slots;
+};
+
+bool station_index_init(station_index_t &idx, int capacity);
+void station_index_free(station_index_t &idx);
+bool station_index_add(station_index_t &idx, const char *key, int value);
+int station_index_find(const station_index_t &idx, const char *key, int len, int &iter);
+
+#endif // _H_STATION_INDEX_
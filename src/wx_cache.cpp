@@ -0,0 +1,221 @@
+#include <Arduino.h>
+#include "wx_cache.h"
+#include "wx_snapshot.h"
+#include "metar.h"
+#include "log.h"
+
+#if CONFIG_IDF_TARGET_ESP32S3
+#include "esp32s3/rom/crc.h"
+#else
+#include "rom/crc.h"
+#endif
+
+// the file is a header, then an entry (and its METAR text) per airport with
+// weather.  entries are keyed by airport name, so they still land in the
+// right place if airports.csv changes.
+struct wx_cache_header_t {
+    uint32_t magic;         // WX_CACHE_MAGIC
+    uint16_t version;       // WX_CACHE_VERSION
+    uint16_t count;         // entries
+    uint32_t saved;         // when (UTC)
+    uint32_t crc;           // of everything after the header
+};
+
+struct __attribute__((packed)) wx_cache_entry_t {
+    char name[8];           // airport
+    uint32_t obs_time;
+    uint32_t wx_flags;
+    float vis;
+    float altimiter;
+    float temp_c;
+    float dew_c;
+    int16_t wind_dir;
+    int16_t wind_speed;
+    int16_t wind_gust;
+    int16_t rvr;
+    int16_t vert_vis;
+    int8_t sky_cover[WX_CLOUD_RECORDS];
+    int16_t cloud_base[WX_CLOUD_RECORDS];
+    char report_time[8];
+    uint8_t wx_cond;
+    uint8_t cloud_idx;
+    uint8_t speci;
+    uint8_t lightning;
+    uint16_t metar_len;     // followed by this much METAR text
+};
+
+// what was last written (refresh task only)
+static uint32_t saved_generation;
+static time_t last_save;
+
+static void to_entry(wx_cache_entry_t &e, const char *name, const wx_t *wx)
+{
+    memset(&e, 0, sizeof(e));
+    strlcpy(e.name, name, sizeof(e.name));
+    e.obs_time = wx->obs_time;
+    e.wx_flags = wx->wx_flags;
+    e.vis = wx->vis;
+    e.altimiter = wx->altimiter;
+    e.temp_c = wx->temp_c;
+    e.dew_c = wx->dew_c;
+    e.wind_dir = wx->wind_dir;
+    e.wind_speed = wx->wind_speed;
+    e.wind_gust = wx->wind_gust;
+    e.rvr = wx->rvr;
+    e.vert_vis = wx->vert_vis;
+    for (int i = 0; i < WX_CLOUD_RECORDS; i++) {
+        e.sky_cover[i] = wx->clouds[i].sky_cover;
+        e.cloud_base[i] = wx->clouds[i].altitude;
+    }
+    memcpy(e.report_time, wx->report_time, sizeof(e.report_time));
+    e.wx_cond = wx->wx_cond;
+    e.cloud_idx = wx->cloud_idx;
+    e.speci = wx->speci;
+    e.lightning = wx->lightning;
+    e.metar_len = strlen(wx->metar);
+}
+
+static void from_entry(wx_t *wx, const wx_cache_entry_t &e)
+{
+    wx->obs_time = e.obs_time;
+    wx->wx_flags = e.wx_flags;
+    wx->vis = e.vis;
+    wx->altimiter = e.altimiter;
+    wx->temp_c = e.temp_c;
+    wx->dew_c = e.dew_c;
+    wx->wind_dir = e.wind_dir;
+    wx->wind_speed = e.wind_speed;
+    wx->wind_gust = e.wind_gust;
+    wx->rvr = e.rvr;
+    wx->vert_vis = e.vert_vis;
+    for (int i = 0; i < WX_CLOUD_RECORDS; i++) {
+        wx->clouds[i].sky_cover = e.sky_cover[i];
+        wx->clouds[i].altitude = e.cloud_base[i];
+    }
+    memcpy(wx->report_time, e.report_time, sizeof(wx->report_time));
+    wx->report_time[sizeof(wx->report_time) - 1] = '\0';
+    wx->wx_cond = e.wx_cond < WX_COND_MAX ? e.wx_cond : WX_COND_VFR;
+    wx->cloud_idx = e.cloud_idx;
+    wx->speci = e.speci;
+    wx->lightning = e.lightning;
+}
+
+// not threadsafe (call before the parse and refresh tasks start)
+int wx_cache_load()
+{
+    FILE *f = fopen(WX_CACHE_FILE, "r");
+    if (f == NULL) {
+        logInfo("wx_cache_load: no %s\n", WX_CACHE_FILE);
+        return 0;
+    }
+    wx_cache_header_t hdr;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != WX_CACHE_MAGIC || hdr.version != WX_CACHE_VERSION) {
+        logError("wx_cache_load: %s isn't a version %d cache\n", WX_CACHE_FILE, WX_CACHE_VERSION);
+        fclose(f);
+        return 0;
+    }
+
+    // if the clock's been set (a warm reset), reports that have gone stale
+    // since we saved them stay stale.  otherwise (a cold boot, no RTC) they
+    // could be days old: they're marked cached, which the LEDs show dimmed,
+    // until commit_airport_wx() can age them against the real time.
+    time_t now;
+    time(&now);
+    time_t oldest = now > WX_CACHE_TIME_VALID ? now - METAR_MAX_AGE : 0;
+
+    // the snapshot isn't published until the whole file checks out; if it
+    // doesn't, the next wx_begin_update() reuses it.  the text goes straight
+    // into its arena (skipped entries just waste a little of it).
+    wx_snapshot_t *snap = wx_begin_update();
+    uint32_t crc = 0;
+    int loaded = 0;
+    bool ok = true;
+    for (int i = 0; i < hdr.count && ok; i++) {
+        wx_cache_entry_t e;
+        ok = (fread(&e, sizeof(e), 1, f) == 1);
+        if (!ok) break;
+        char *text = (char*) arena_alloc(&snap->text, e.metar_len + 1);
+        ok = (text != NULL && fread(text, 1, e.metar_len, f) == e.metar_len);
+        if (!ok) break;
+        text[e.metar_len] = '\0';
+        crc = crc32_le(crc, (const uint8_t*) &e, sizeof(e));
+        crc = crc32_le(crc, (const uint8_t*) text, e.metar_len);
+
+        e.name[sizeof(e.name) - 1] = '\0';
+        int index = airport_index(e.name);
+        if (index < 0 || (time_t) e.obs_time < oldest) continue;
+        wx_t *wx = snap->wx + index;
+        from_entry(wx, e);
+        wx->metar = text;
+        wx->valid_metar = true;
+        wx->cached = (oldest == 0);
+        loaded++;
+    }
+    fclose(f);
+
+    if (!ok || crc != hdr.crc) {
+        logError("wx_cache_load: %s is damaged, ignoring it\n", WX_CACHE_FILE);
+        return 0;
+    }
+    wx_publish(snap);
+    saved_generation = snap->generation;
+    logInfo("wx_cache_load: weather for %d airports, saved at %u\n", loaded, hdr.saved);
+    return loaded;
+}
+
+// not threadsafe (refresh task only)
+void wx_cache_save(time_t now)
+{
+    if (last_save != 0 && now - last_save < WX_CACHE_INTERVAL) return;
+
+    const wx_snapshot_t *snap = wx_acquire(WX_READER_CACHE);
+    if (snap->generation == saved_generation) {
+        wx_release(WX_READER_CACHE);
+        return;
+    }
+
+    uint32_t start = millis();
+    FILE *f = fopen(WX_CACHE_TEMP, "w");
+    if (f == NULL) {
+        logError("wx_cache_save: can't create %s\n", WX_CACHE_TEMP);
+        wx_release(WX_READER_CACHE);
+        return;
+    }
+    wx_cache_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = WX_CACHE_MAGIC;
+    hdr.version = WX_CACHE_VERSION;
+    hdr.saved = now;
+    bool ok = (fwrite(&hdr, sizeof(hdr), 1, f) == 1);
+
+    for (int i = 0; i < snap->count && ok; i++) {
+        const wx_t *wx = snap->wx + i;
+        if (!wx->valid_metar || wx->metar == NULL) continue;
+        wx_cache_entry_t e;
+        to_entry(e, get_airport(i)->name, wx);
+        ok = fwrite(&e, sizeof(e), 1, f) == 1 && fwrite(wx->metar, 1, e.metar_len, f) == e.metar_len;
+        hdr.crc = crc32_le(hdr.crc, (const uint8_t*) &e, sizeof(e));
+        hdr.crc = crc32_le(hdr.crc, (const uint8_t*) wx->metar, e.metar_len);
+        hdr.count++;
+    }
+    uint32_t generation = snap->generation;
+    wx_release(WX_READER_CACHE);
+
+    // now the header, with the count and crc.
+    ok = ok && fseek(f, 0, SEEK_SET) == 0 && fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+    ok = (fclose(f) == 0) && ok;
+    // replace the old one only once the new one is all there.
+    if (ok) {
+        remove(WX_CACHE_FILE);
+        ok = (rename(WX_CACHE_TEMP, WX_CACHE_FILE) == 0);
+    }
+    // either way, don't try again until the next interval.
+    last_save = now;
+    if (!ok) {
+        logError("wx_cache_save: failed writing %s\n", WX_CACHE_FILE);
+        remove(WX_CACHE_TEMP);
+        return;
+    }
+    saved_generation = generation;
+    logInfo("wx_cache_save: %d airports in %u ms\n", hdr.count, millis() - start);
+}
@@ -0,0 +1,32 @@
+#ifndef _H_WX_CACHE_
+#define _H_WX_CACHE_
+
+#include <time.h>
+
+// the last good weather, kept in flash so the map has colors right after
+// power on, instead of waiting for wifi and the first refresh.
+
+#define WX_CACHE_FILE "/spiffs/wxcache.bin"
+#define WX_CACHE_TEMP "/spiffs/wxcache.tmp"
+
+#define WX_CACHE_MAGIC (0x31435857)     // 'WXC1'
+#define WX_CACHE_VERSION (1)
+
+// writes are coalesced: at most one per this many seconds, and only when
+// the weather has changed.  (keeps flash wear down)
+#define WX_CACHE_INTERVAL (15*60)
+
+// before this, the clock hasn't been set yet, so we can't tell how old a
+// cached report is.
+#define WX_CACHE_TIME_VALID (1600000000)
+
+// load the cache into the weather snapshot.  call from airportsBegin(),
+// after wx_snapshot_begin() and before metarBegin() starts the parse task.
+// returns the number of airports with weather.
+int wx_cache_load();
+
+// save the current weather, if it's changed and it's been long enough.
+// not threadsafe (refresh task only)
+void wx_cache_save(time_t now);
+
+#endif // _H_WX_CACHE_
@@ -0,0 +1,161 @@
+#include <Arduino.h>
+#include "airports.h"
+#include "wx_flags.h"
+
+#define CODE(a, b) (((a) << 8) | (b))
+
+// a two letter present weather code, or 0 if it isn't one.
+static uint32_t weather_code(char a, char b)
+{
+    switch (CODE(a, b)) {
+    case CODE('V','C'): return WXF_VICINITY;
+    case CODE('T','S'): return WXF_TS;
+    case CODE('S','H'): return WXF_SH;
+    case CODE('F','Z'): return WXF_FZ;
+    case CODE('B','L'): return WXF_BL;
+    case CODE('D','R'): return WXF_BL;
+    case CODE('M','I'): return WXF_SHALLOW;
+    case CODE('P','R'): return WXF_SHALLOW;
+    case CODE('B','C'): return WXF_SHALLOW;
+    case CODE('D','Z'): return WXF_DZ;
+    case CODE('R','A'): return WXF_RA;
+    case CODE('S','N'): return WXF_SN;
+    case CODE('S','G'): return WXF_SN;
+    case CODE('P','L'): return WXF_PL;
+    case CODE('I','C'): return WXF_PL;
+    case CODE('G','R'): return WXF_GR;
+    case CODE('G','S'): return WXF_GR;
+    case CODE('U','P'): return WXF_UP;
+    case CODE('F','G'): return WXF_FG;
+    case CODE('B','R'): return WXF_BR;
+    case CODE('H','Z'): return WXF_HZ;
+    case CODE('F','U'): return WXF_FU;
+    case CODE('V','A'): return WXF_FU;
+    case CODE('D','U'): return WXF_DU;
+    case CODE('S','A'): return WXF_DU;
+    case CODE('S','Q'): return WXF_SQ;
+    case CODE('F','C'): return WXF_FC;
+    case CODE('S','S'): return WXF_SS;
+    case CODE('D','S'): return WXF_SS;
+    case CODE('P','O'): return WXF_SS;
+    default: return 0;
+    }
+}
+
+static inline bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static bool all_digits(const char *t, int len)
+{
+    for (int i = 0; i < len; i++) {
+        if (!is_digit(t[i])) return false;
+    }
+    return len > 0;
+}
+
+static bool token_is(const char *t, int len, const char *word)
+{
+    return strncmp(t, word, len) == 0 && word[len] == '\0';
+}
+
+// a present weather group, i.e. -RA, +TSRAGR, VCSH, FZFG: an optional
+// intensity, then nothing but two letter codes.  all or nothing, so station
+// ids, cloud groups, etc. don't match.
+static uint32_t weather_group(const char *t, int len)
+{
+    uint32_t flags = 0;
+    if (len > 0 && t[0] == '-') {
+        flags = WXF_LIGHT;
+        t++, len--;
+    } else if (len > 0 && t[0] == '+') {
+        flags = WXF_HEAVY;
+        t++, len--;
+    }
+    if (len < 2 || (len & 1)) return 0;
+    for (int i = 0; i < len; i += 2) {
+        uint32_t code = weather_code(t[i], t[i + 1]);
+        if (code == 0) return 0;
+        flags |= code;
+    }
+    return flags;
+}
+
+// runway visual range, i.e. R28L/2400FT, R09/P6000FT, R24/1000V1500FT,
+// R16/0550N (meters, outside the US).  returns feet, or -1 if it isn't one.
+static int rvr_group(const char *t, int len)
+{
+    if (len < 5 || t[0] != 'R' || !is_digit(t[1])) return -1;
+    const char *end = t + len;
+    const char *p = (const char*) memchr(t, '/', len);
+    if (p == NULL) return -1;
+    p++;
+    if (p < end && (*p == 'P' || *p == 'M')) p++;
+    int val = 0, digits = 0;
+    for ( ; p < end && is_digit(*p); p++, digits++) val = val * 10 + (*p - '0');
+    if (digits == 0 || digits > 4) return -1;
+    bool feet = (len > 2 && end[-2] == 'F' && end[-1] == 'T');
+    return feet ? val : val * 328 / 100;
+}
+
+// threadsafe
+void scan_metar(wx_t *wx, const char *text, int len)
+{
+    // the body doesn't start until after the time group (DDHHMMZ); before
+    // that, the station id could look like anything.  after a trend (TEMPO,
+    // BECMG, NOSIG) it's forecast, not observed weather.
+    enum { HEADER, BODY, TREND, REMARKS } part = HEADER;
+    uint32_t flags = 0;
+    int rvr = -1, vert_vis = -1;
+
+    const char *p = text, *end = text + len;
+    while (p < end) {
+        while (p < end && (*p == ' ' || *p == '\n' || *p == '\r')) p++;
+        const char *t = p;
+        while (p < end && *p != ' ' && *p != '\n' && *p != '\r' && *p != '\0') p++;
+        int n = p - t;
+        if (n == 0) break;
+
+        if (token_is(t, n, "RMK")) {
+            part = REMARKS;
+            continue;
+        }
+        switch (part) {
+        case HEADER:
+            if (n == 7 && t[6] == 'Z' && all_digits(t, 6)) part = BODY;
+            break;
+        case BODY:
+            if (token_is(t, n, "TEMPO") || token_is(t, n, "BECMG") || token_is(t, n, "NOSIG")) {
+                part = TREND;
+            } else if (token_is(t, n, "AUTO")) {
+                flags |= WXF_AUTO;
+            } else if (n >= 4 && t[0] == 'V' && t[1] == 'V') {
+                flags |= WXF_VV;
+                if (all_digits(t + 2, n - 2)) vert_vis = atoi(t + 2) * 100;
+            } else if (t[0] == 'R' && n >= 5 && is_digit(t[1])) {
+                int ft = rvr_group(t, n);
+                if (ft >= 0) {
+                    flags |= WXF_RVR;
+                    if (rvr < 0 || ft < rvr) rvr = ft;
+                }
+            } else {
+                flags |= weather_group(t, n);
+            }
+            break;
+        case TREND:
+            break;
+        case REMARKS:
+            if (n >= 3 && strncmp(t, "LTG", 3) == 0) flags |= WXF_LTG;
+            else if (token_is(t, n, "TSNO")) flags |= WXF_TSNO;
+            else if (token_is(t, n, "$")) flags |= WXF_MAINT;
+            else if (token_is(t, n, "AO1") || token_is(t, n, "AO2")) flags |= WXF_AUTO;
+            break;
+        }
+    }
+
+    wx->wx_flags = flags;
+    wx->rvr = rvr;
+    wx->vert_vis = vert_vis;
+    wx->lightning = (flags & (WXF_TS | WXF_LTG)) != 0;
+}
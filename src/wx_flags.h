@@ -0,0 +1,61 @@
+#ifndef _H_WX_FLAGS_
+#define _H_WX_FLAGS_
+
+#include <stdint.h>
+
+// what's in the raw METAR text, beyond the columns the API breaks out.
+// present weather (the 4678 groups), qualifiers, and a few remarks.
+
+// intensity / proximity
+#define WXF_LIGHT       (1u << 0)   // -
+#define WXF_HEAVY       (1u << 1)   // +
+#define WXF_VICINITY    (1u << 2)   // VC
+
+// descriptors
+#define WXF_TS          (1u << 3)   // thunderstorm
+#define WXF_SH          (1u << 4)   // showers
+#define WXF_FZ          (1u << 5)   // freezing
+#define WXF_BL          (1u << 6)   // blowing (also DR, drifting)
+#define WXF_SHALLOW     (1u << 7)   // MI, PR, BC: shallow, partial, patches
+
+// precipitation
+#define WXF_DZ          (1u << 8)   // drizzle
+#define WXF_RA          (1u << 9)   // rain
+#define WXF_SN          (1u << 10)  // snow (also SG, snow grains)
+#define WXF_PL          (1u << 11)  // ice pellets (also IC, ice crystals)
+#define WXF_GR          (1u << 12)  // hail (also GS, small hail)
+#define WXF_UP          (1u << 13)  // unknown precipitation
+
+// obscurations
+#define WXF_FG          (1u << 14)  // fog
+#define WXF_BR          (1u << 15)  // mist
+#define WXF_HZ          (1u << 16)  // haze
+#define WXF_FU          (1u << 17)  // smoke (also VA, volcanic ash)
+#define WXF_DU          (1u << 18)  // dust, sand (DU, SA)
+
+// other
+#define WXF_SQ          (1u << 19)  // squalls
+#define WXF_FC          (1u << 20)  // funnel cloud, tornado
+#define WXF_SS          (1u << 21)  // sand or dust storm (SS, DS, PO)
+
+// other groups
+#define WXF_RVR         (1u << 22)  // runway visual range reported
+#define WXF_VV          (1u << 23)  // vertical visibility (sky obscured)
+
+// remarks
+#define WXF_LTG         (1u << 24)  // lightning observed (LTG...)
+#define WXF_TSNO        (1u << 25)  // lightning detector not working
+#define WXF_MAINT       (1u << 26)  // '$', station needs maintenance
+#define WXF_AUTO        (1u << 27)  // automated station (AO1, AO2)
+
+#define WXF_PRECIP      (WXF_DZ | WXF_RA | WXF_SN | WXF_PL | WXF_GR | WXF_UP)
+#define WXF_OBSCURED    (WXF_FG | WXF_BR | WXF_HZ | WXF_FU | WXF_DU)
+
+struct wx_t;
+
+// one pass over the raw METAR 'text' (not necessarily '\0' terminated);
+// fills in wx_flags, rvr, vert_vis and lightning.  doesn't allocate.
+// threadsafe
+void scan_metar(wx_t *wx, const char *text, int len);
+
+#endif // _H_WX_FLAGS_
@@ -0,0 +1,104 @@
+#include <Arduino.h>
+#include "wx_schedule.h"
+#include "log.h"
+#include "mutex.h"
+
+// the parse task writes this (schedule_result(), from commit_airport_wx())
+// and reads obs_time (stage_station()); the refresh task reads it to decide
+// what to fetch.  time_t is 64 bits, which isn't read or written in one go,
+// so everything after schedule_begin() takes the lock.
+static wx_sched_t *sched;
+static int num_sched;
+
+// not threadsafe (call once, before the refresh and parse tasks start)
+bool schedule_begin(int num_airports)
+{
+    sched = (wx_sched_t*) calloc(num_airports, sizeof(wx_sched_t));
+    if (sched == NULL) {
+        logError("schedule_begin: failed to allocate %d entries\n", num_airports);
+        return false;
+    }
+    num_sched = num_airports;
+    for (int i = 0; i < num_sched; i++) {
+        sched[i].next_fetch = 0;        // fetch everything right away.
+        sched[i].issue_minute = WX_ISSUE_MINUTE;
+    }
+    return true;
+}
+
+// threadsafe
+bool schedule_due(int index, time_t when)
+{
+    _lock();
+    bool due = sched[index].next_fetch <= when;
+    _release();
+    return due;
+}
+
+// next routine report after 'obs', for a station that issues at 'minute'.
+static time_t next_routine(time_t obs, int minute)
+{
+    time_t t = obs - (obs % 3600) + minute * 60;
+    // a report at (or a little after) the routine time IS the routine report.
+    while (t <= obs + 10*60) t += 3600;
+    return t;
+}
+
+// threadsafe
+void schedule_result(int index, const wx_t *wx, time_t now)
+{
+    _lock();
+    wx_sched_t *s = sched + index;
+    time_t next;
+
+    if (wx == NULL || !wx->valid_metar || wx->obs_time == 0) {
+        // nothing for this station.
+        next = now + WX_RETRY_MISSING;
+    } else if (wx->obs_time != s->obs_time) {
+        // new report.
+        s->obs_time = wx->obs_time;
+        s->late = 0;
+        if (!wx->speci) {
+            // learn when this station's routine reports go out.
+            int minute = (wx->obs_time % 3600) / 60;
+            if (minute >= 40) s->issue_minute = minute;
+        }
+        next = next_routine(s->obs_time, s->issue_minute) + WX_PUBLISH_DELAY;
+        if (wx->speci || wx->wx_cond >= WX_COND_IFR) {
+            if (next > now + WX_POLL_ACTIVE) next = now + WX_POLL_ACTIVE;
+        }
+    } else {
+        // we asked, but there's nothing newer yet.  back off (5, 10, 20 minutes)
+        if (s->late < 2) s->late++;
+        next = now + (WX_RETRY_LATE << (s->late - 1));
+        if (wx->wx_cond >= WX_COND_IFR && next > now + WX_POLL_ACTIVE) next = now + WX_POLL_ACTIVE;
+    }
+
+    if (next > now + WX_STALE_TIME) next = now + WX_STALE_TIME;
+    if (next < now + 60) next = now + 60;
+    s->next_fetch = next;
+    time_t obs = s->obs_time;
+    _release();
+    logDebug("schedule: [%d] obs=%d next fetch in %d s\n", index, (int) obs, (int)(next - now));
+}
+
+// threadsafe
+time_t schedule_obs_time(int index)
+{
+    _lock();
+    time_t obs = sched[index].obs_time;
+    _release();
+    return obs;
+}
+
+// threadsafe
+time_t schedule_next_deadline()
+{
+    _lock();
+    time_t next = 0;
+    for (int i = 0; i < num_sched; i++) {
+        if (i == 0 || sched[i].next_fetch < next) next = sched[i].next_fetch;
+    }
+    _release();
+    return next;
+}
@@ -0,0 +1,47 @@
+#ifndef _H_WX_SCHEDULE_
+#define _H_WX_SCHEDULE_
+
+#include <time.h>
+#include "airports.h"
+
+// decides when each station should be fetched next, based on when its
+// METARs are actually issued rather than when we last asked.
+//
+// routine METARs go out once an hour, usually between :51 and :56; we
+// learn each station's minute and fetch a few minutes after it.  stations
+// reporting IFR/LIFR, or that just sent a SPECI, are polled more often.
+//
+// the parse task records results and checks observation times; the refresh
+// task decides what's due.  everything but schedule_begin() is threadsafe.
+
+#define WX_ISSUE_MINUTE (53)        // default routine issue minute
+#define WX_PUBLISH_DELAY (4*60)     // obs time -> available from the server
+#define WX_POLL_ACTIVE (15*60)      // IFR/LIFR/SPECI stations
+#define WX_RETRY_LATE (5*60)        // report didn't show up when expected (doubles)
+#define WX_RETRY_MISSING (30*60)    // no report at all for station
+#define WX_STALE_TIME (3600)        // never wait longer than this
+#define WX_BATCH_SLACK (2*60)       // fetch stations due this soon along with due ones
+
+struct wx_sched_t {
+    time_t next_fetch;      // when to ask for this station next
+    time_t obs_time;        // observation time of the newest report we have
+    int8_t issue_minute;    // learned minute of routine reports
+    uint8_t late;           // fetches since the report was due, without a new one
+};
+
+bool schedule_begin(int num_airports);
+
+// is airport 'index' due to be fetched at 'when'?
+bool schedule_due(int index, time_t when);
+
+// record the result of fetching airport 'index'.  'wx' is the airport's
+// current weather (which may be unchanged, or invalid).
+void schedule_result(int index, const wx_t *wx, time_t now);
+
+// observation time of the newest report we've seen for airport 'index', 0 if none.
+time_t schedule_obs_time(int index);
+
+// earliest next_fetch of any airport.
+time_t schedule_next_deadline();
+
+#endif // _H_WX_SCHEDULE_
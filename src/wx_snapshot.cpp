@@ -0,0 +1,110 @@
+#include <Arduino.h>
+#include <atomic>
+
+#include "wx_snapshot.h"
+#include "log.h"
+
+static wx_snapshot_t pool[WX_SNAPSHOTS];
+static std::atomic<wx_snapshot_t*> current(NULL);
+static std::atomic<wx_snapshot_t*> hazard[WX_MAX_READERS];
+
+// not threadsafe (call once, before anyone reads)
+bool wx_snapshot_begin(int num_airports)
+{
+    for (int i = 0; i < WX_SNAPSHOTS; i++) {
+        pool[i].generation = 0;
+        pool[i].count = num_airports;
+        pool[i].wx = (wx_t*) calloc(num_airports, sizeof(wx_t));
+        pool[i].render = (uint8_t*) calloc(num_airports, sizeof(uint8_t));
+        arena_init(&pool[i].text, WX_TEXT_CHUNK);
+        if (pool[i].wx == NULL || pool[i].render == NULL) {
+            logError("wx_snapshot_begin: failed to allocate %d weather records\n", num_airports);
+            return false;
+        }
+    }
+    for (int i = 0; i < WX_MAX_READERS; i++) hazard[i].store(NULL);
+    current.store(pool);
+    return true;
+}
+
+// threadsafe
+const wx_snapshot_t *wx_acquire(int reader)
+{
+    wx_snapshot_t *snap;
+    // publish our hazard pointer, then make sure the snapshot wasn't
+    // retired (and possibly recycled) before the writer could see it.
+    do {
+        snap = current.load();
+        hazard[reader].store(snap);
+    } while (snap != current.load());
+    return snap;
+}
+
+// threadsafe
+void wx_release(int reader)
+{
+    hazard[reader].store(NULL);
+}
+
+static bool in_use(wx_snapshot_t *snap)
+{
+    if (snap == current.load()) return true;
+    for (int i = 0; i < WX_MAX_READERS; i++) {
+        if (hazard[i].load() == snap) return true;
+    }
+    return false;
+}
+
+// not threadsafe (parse task only, see wx_snapshot.h)
+wx_snapshot_t *wx_begin_update()
+{
+    wx_snapshot_t *snap = NULL;
+    while (snap == NULL) {
+        for (int i = 0; i < WX_SNAPSHOTS && snap == NULL; i++) {
+            if (!in_use(pool + i)) snap = pool + i;
+        }
+        // a reader still has the retired snapshot.  they don't hold on long.
+        if (snap == NULL) vTaskDelay(1);
+    }
+
+    // start from a copy of the current weather.  text that's been replaced
+    // since this snapshot was last used isn't copied, so the arena doesn't grow.
+    const wx_snapshot_t *cur = current.load();
+    arena_reset(&snap->text);
+    for (int i = 0; i < snap->count; i++) {
+        wx_t *wx = snap->wx + i;
+        *wx = cur->wx[i];
+        if (wx->metar) wx->metar = arena_strdup(&snap->text, wx->metar);
+    }
+    snap->generation = cur->generation;
+    return snap;
+}
+
+// for stats only: the numbers may be mid-update.
+void wx_text_stats(size_t &used, size_t &capacity)
+{
+    used = capacity = 0;
+    for (int i = 0; i < WX_SNAPSHOTS; i++) {
+        used += pool[i].text.used;
+        capacity += pool[i].text.capacity;
+    }
+}
+
+static uint8_t render_byte(const wx_t *wx)
+{
+    if (wx->metar == NULL || !wx->valid_metar) return 0;
+    uint8_t r = WX_RENDER_VALID;
+    r |= wx->wx_cond < WX_COND_MAX ? wx->wx_cond : WX_RENDER_COND;
+    if (wx->lightning) r |= WX_RENDER_LIGHTNING;
+    if (wx->wind_gust >= WX_GUSTY_KT) r |= WX_RENDER_GUSTY;
+    if (wx->cached) r |= WX_RENDER_CACHED;
+    return r;
+}
+
+// not threadsafe (parse task only, see wx_snapshot.h)
+void wx_publish(wx_snapshot_t *snap)
+{
+    for (int i = 0; i < snap->count; i++) snap->render[i] = render_byte(snap->wx + i);
+    snap->generation++;
+    current.store(snap);
+}
@@ -0,0 +1,65 @@
+#ifndef _H_WX_SNAPSHOT_
+#define _H_WX_SNAPSHOT_
+
+#include "airports.h"
+#include "arena.h"
+
+// weather for every airport, as of one refresh.  a published snapshot is
+// never modified: the parse task builds the next one on the side (in
+// commit_airport_wx()) and publishes it with a single pointer store.
+// readers never take a lock.
+//
+// reclamation uses one hazard pointer per reader: a retired snapshot is
+// only reused once no reader has it acquired.
+//
+// each snapshot's METAR text lives in its own arena, which is reset and
+// refilled with just the live text when the snapshot is reused.  so the
+// two arenas ping-pong, and a refresh doesn't malloc or free any text.
+struct wx_snapshot_t {
+    uint32_t generation;    // bumped on every publish
+    int count;              // == num_airports
+    wx_t *wx;               // indexed by airport index
+    uint8_t *render;        // WX_RENDER_XXX, derived from wx[] on publish
+    arena_t text;           // wx[].metar
+};
+
+// all the LED loop needs to know about an airport, in one byte, so a frame
+// walks 'count' bytes rather than 'count' wx_t's.
+#define WX_RENDER_COND (0x07)       // WX_COND_XXX (anything else is an error)
+#define WX_RENDER_CACHED (0x10)     // wx_t.cached: shown dimmed until we know its age
+#define WX_RENDER_GUSTY (0x20)      // gusts of WX_GUSTY_KT or more
+#define WX_RENDER_LIGHTNING (0x40)
+#define WX_RENDER_VALID (0x80)      // has a (valid) METAR
+
+#define WX_GUSTY_KT (25)
+
+#define WX_TEXT_CHUNK (8*1024)
+
+// each reading task gets its own slot.  a reader must not acquire twice
+// without releasing.
+#define WX_READER_UI (0)        // arduino loop(): GUI, menus
+#define WX_READER_CACHE (1)     // refresh task, saving the warm start cache
+#define WX_READER_LED (2)       // LED task
+#define WX_MAX_READERS (3)
+
+// two snapshots: the published one, and the one being built.
+#define WX_SNAPSHOTS (2)
+
+bool wx_snapshot_begin(int num_airports);
+
+// reader side.  hold it briefly -- the writer waits for it.
+const wx_snapshot_t *wx_acquire(int reader);
+void wx_release(int reader);
+
+// writer side.  there's one writer: the parse task, or wx_cache_load()
+// before the parse task starts.  nothing else (the refresh task included)
+// may begin an update or publish while it might be.  returns a copy of the
+// current snapshot to modify (wx[] only), then publish.  new METAR text
+// goes in snap->text.
+wx_snapshot_t *wx_begin_update();
+void wx_publish(wx_snapshot_t *snap);
+
+// bytes of METAR text in use, and held, by all the snapshots' arenas.
+void wx_text_stats(size_t &used, size_t &capacity);
+
+#endif // _H_WX_SNAPSHOT_
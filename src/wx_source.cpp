@@ -0,0 +1,162 @@
+#include <Arduino.h>
+#include "wx_source.h"
+#include "filesystem.h"
+#include "vfs_fs.h"
+#include "log.h"
+
+// what's in a file, from its name: .json (or .json.gz) is the JSON API's
+// format, anything else is CSV.
+static void file_format(const String &path, wx_response_t &resp)
+{
+    resp.gzip = path.endsWith(".gz");
+    resp.json = path.endsWith(".json") || path.endsWith(".json.gz");
+}
+
+// a METAR file (CSV like the bulk file, or JSON like the API's responses;
+// .gz is fine too).  it's only read again when it changes.
+class FileSource : public WeatherSource {
+public:
+    FileSource(const char *_path) : path(_path), last_size(0), last_write(0) {}
+
+    const char *name() const { return "file"; }
+
+    Stream *open(const String *stations, int hours, wx_response_t &resp)
+    {
+        resp.status = WX_RESPONSE_FAILED;
+        resp.filtered = true;
+        file_format(path, resp);
+
+        file = fs::VFS.open(path.c_str(), "r");
+        if (!file) {
+            logError("FileSource: can't open %s\n", path.c_str());
+            return NULL;
+        }
+        if (file.size() == last_size && file.getLastWrite() == last_write) {
+            file.close();
+            resp.status = WX_RESPONSE_NOT_MODIFIED;
+            return NULL;
+        }
+        last_size = file.size();
+        last_write = file.getLastWrite();
+        logInfo("FileSource: reading %s (%d bytes)\n", path.c_str(), (int) last_size);
+        resp.status = WX_RESPONSE_OK;
+        return &file;
+    }
+
+    bool close()
+    {
+        file.close();
+        return true;
+    }
+
+private:
+    String path;
+    fs::File file;
+    size_t last_size;
+    time_t last_write;
+};
+
+// recorded responses, each served from its time on a timeline that starts
+// with the first request.  'dir'/index.txt has a line per capture:
+//     <seconds> <file name, relative to dir>
+// in time order ('#' lines are comments).  captures keep their original
+// observation times, so once the clock is set, old ones age out
+// (METAR_MAX_AGE) like any other report.
+class ReplaySource : public WeatherSource {
+public:
+    ReplaySource(const char *_dir) : dir(_dir), num_captures(-1), current(-1), start(0) {}
+
+    const char *name() const { return "replay"; }
+
+    Stream *open(const String *stations, int hours, wx_response_t &resp)
+    {
+        resp.status = WX_RESPONSE_FAILED;
+        resp.gzip = false;
+        resp.json = false;
+        resp.filtered = true;
+
+        if (num_captures < 0) loadIndex();
+        if (start == 0) start = millis();
+        uint32_t elapsed = (millis() - start) / 1000 * WX_REPLAY_SPEED;
+
+        int i = current;
+        while (i + 1 < num_captures && captures[i + 1].at <= elapsed) i++;
+        if (i == current) {
+            // still on the same one (or nothing's due yet)
+            resp.status = WX_RESPONSE_NOT_MODIFIED;
+            return NULL;
+        }
+        current = i;
+
+        String path = dir + "/" + captures[i].name;
+        file = fs::VFS.open(path.c_str(), "r");
+        if (!file) {
+            logError("ReplaySource: can't open %s\n", path.c_str());
+            return NULL;
+        }
+        logInfo("ReplaySource: %u s: serving %s (%d bytes)\n", elapsed, path.c_str(), (int) file.size());
+        file_format(path, resp);
+        resp.status = WX_RESPONSE_OK;
+        return &file;
+    }
+
+    bool close()
+    {
+        file.close();
+        return true;
+    }
+
+private:
+    struct capture_t {
+        uint32_t at;        // seconds from the start
+        char name[32];
+    };
+
+    void loadIndex()
+    {
+        num_captures = 0;
+        String path = dir + "/index.txt";
+        fs::File index = fs::VFS.open(path.c_str(), "r");
+        if (!index) {
+            logError("ReplaySource: can't open %s\n", path.c_str());
+            return;
+        }
+        while (index.available() && num_captures < WX_REPLAY_MAX_CAPTURES) {
+            String line = index.readStringUntil('\n');
+            line.trim();
+            if (line.length() == 0 || line[0] == '#') continue;
+            capture_t *c = captures + num_captures;
+            if (sscanf(line.c_str(), "%u %31s", &c->at, c->name) == 2) num_captures++;
+        }
+        index.close();
+        logInfo("ReplaySource: %d captures in %s\n", num_captures, path.c_str());
+    }
+
+    String dir;
+    capture_t captures[WX_REPLAY_MAX_CAPTURES];
+    int num_captures;
+    int current;
+    uint32_t start;
+    fs::File file;
+};
+
+WeatherSource *new_file_source(const char *path)
+{
+    return new FileSource(path);
+}
+
+WeatherSource *new_replay_source(const char *dir)
+{
+    return new ReplaySource(dir);
+}
+
+WeatherSource *wx_source_create()
+{
+#if WX_SOURCE == WX_SOURCE_FILE
+    return new_file_source(data_path(WX_SOURCE_FILE_NAME));
+#elif WX_SOURCE == WX_SOURCE_REPLAY
+    return new_replay_source(data_path(WX_SOURCE_REPLAY_DIR));
+#else
+    return new_http_source();
+#endif
+}
@@ -0,0 +1,71 @@
+#ifndef _H_WX_SOURCE_
+#define _H_WX_SOURCE_
+
+#include <Arduino.h>
+
+#define WX_RESPONSE_OK (0)
+#define WX_RESPONSE_NOT_MODIFIED (1)   // nothing new since last time
+#define WX_RESPONSE_FAILED (2)
+
+struct wx_response_t {
+    int status;         // WX_RESPONSE_XXX above
+    bool gzip;          // body is gzipped
+    bool json;          // body is the JSON API's array of stations, not CSV
+    bool filtered;      // body has stations we didn't ask for, to be skipped
+};
+
+// where METARs come from.  a source hands back the body of a response
+// (a METAR CSV or JSON array, possibly gzipped) as a Stream; the network task copies it
+// to the parse task, and calls close() when it hits the end.
+// only used by the network (refresh) task.
+class WeatherSource {
+public:
+    virtual ~WeatherSource() {}
+
+    virtual const char *name() const = 0;
+
+    // does it need wifi?  if not, we don't wait for it.
+    virtual bool needsNetwork() const { return false; }
+
+    // does every response have every station?  if so, ask for everything at once.
+    virtual bool bulkOnly() const { return true; }
+
+    // longest station list open() can take, 0 if there's no limit.
+    virtual int maxStationsLength() const { return 0; }
+
+    // start a request for 'stations' (comma separated; NULL means all of
+    // them), reports from the last 'hours'.  returns the body, or NULL if
+    // there isn't one (see resp.status)
+    virtual Stream *open(const String *stations, int hours, wx_response_t &resp) = 0;
+
+    // done with the body returned by open().  false if it ended early.
+    virtual bool close() = 0;
+};
+
+#define WX_SOURCE_HTTP (0)      // the aviationweather.gov API
+#define WX_SOURCE_FILE (1)      // a METAR CSV on the SD card (i.e. for an offline map)
+#define WX_SOURCE_REPLAY (2)    // recorded responses, served on a timeline
+
+// pick with -D WX_SOURCE=...
+#ifndef WX_SOURCE
+#define WX_SOURCE WX_SOURCE_HTTP
+#endif
+
+#define WX_SOURCE_FILE_NAME "metars.csv"        // in the data directory (or .json, .gz)
+#define WX_SOURCE_REPLAY_DIR "replay"           // ... with an index.txt
+
+// replay time runs this many times faster than real time.
+#ifndef WX_REPLAY_SPEED
+#define WX_REPLAY_SPEED (1)
+#endif
+
+#define WX_REPLAY_MAX_CAPTURES (64)
+
+WeatherSource *new_http_source();
+WeatherSource *new_file_source(const char *path);
+WeatherSource *new_replay_source(const char *dir);
+
+// the source chosen by WX_SOURCE.
+WeatherSource *wx_source_create();
+
+#endif // _H_WX_SOURCE_
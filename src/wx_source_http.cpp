@@ -0,0 +1,239 @@
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <WiFiClientSecure.h>
+#include "wx_source.h"
+#include "metar.h"
+#include "log.h"
+#include "msgbox.h"
+#include "http_body.h"
+
+// override with -D METAR_URL=... to point at a local test server.
+// (the old ADDS dataserver_current endpoint has been retired)
+#ifndef METAR_URL
+#define METAR_URL "https://aviationweather.gov/api/data/metar?format=json"
+#endif
+
+// the bulk file is still CSV.
+#ifndef METAR_BULK_URL
+#define METAR_BULK_URL "https://aviationweather.gov/data/cache/metars.cache.csv.gz"
+#endif
+
+static const String metarUrl = METAR_URL;
+static const String metarBulkUrl = METAR_BULK_URL;
+
+// validators from the last few responses, so a repeated request can be
+// answered with a 304.  URLs only repeat within the hour (see update_airport_wx)
+// so a handful of entries is plenty.
+#define VALIDATOR_CACHE_SIZE (4)
+
+struct validator_t {
+    uint32_t url_hash;
+    char etag[64];
+    char last_modified[32];
+};
+
+static validator_t validators[VALIDATOR_CACHE_SIZE];
+static int next_validator;
+
+static uint32_t url_hash(const String &url)
+{
+    uint32_t h = 2166136261u;
+    for (const char *p = url.c_str(); *p; p++) h = (h ^ (uint8_t)*p) * 16777619u;
+    return h;
+}
+
+static validator_t *find_validator(uint32_t hash)
+{
+    for (int i = 0; i < VALIDATOR_CACHE_SIZE; i++) {
+        if (validators[i].url_hash == hash) return validators + i;
+    }
+    return NULL;
+}
+
+static void save_validator(uint32_t hash, const String &etag, const String &last_modified)
+{
+    if (etag.length() == 0 && last_modified.length() == 0) return;
+    validator_t *v = find_validator(hash);
+    if (v == NULL) {
+        v = validators + next_validator;
+        next_validator = (next_validator + 1) % VALIDATOR_CACHE_SIZE;
+    }
+    v->url_hash = hash;
+    strlcpy(v->etag, etag.c_str(), sizeof(v->etag));
+    strlcpy(v->last_modified, last_modified.c_str(), sizeof(v->last_modified));
+}
+
+// connect 'client' to the host in 'url' (http[s]://host[:port]/...)
+static bool connect_to(WiFiClient &client, const String &url)
+{
+    int host_start = url.indexOf("://");
+    if (host_start < 0) return false;
+    host_start += 3;
+    int path = url.indexOf('/', host_start);
+    if (path < 0) path = url.length();
+    String host = url.substring(host_start, path);
+    uint16_t port = url.startsWith("https:") ? 443 : 80;
+    int colon = host.indexOf(':');
+    if (colon >= 0) {
+        port = host.substring(colon + 1).toInt();
+        host = host.substring(0, colon);
+    }
+    if (!client.connect(host.c_str(), port)) {
+        logError("METAR: failed to connect to %s:%d\n", host.c_str(), port);
+        return false;
+    }
+    metar_stats.connects++;
+    return true;
+}
+
+// the aviationweather.gov API, over one connection that's kept open across
+// batches and refresh cycles, so we only pay for the TLS handshake when the
+// server drops us.  (plain http is only for pointing METAR_URL at a local server)
+class HttpSource : public WeatherSource {
+public:
+    HttpSource() : body(NULL) {}
+
+    const char *name() const { return "http"; }
+    bool needsNetwork() const { return true; }
+    bool bulkOnly() const { return false; }
+    int maxStationsLength() const { return METAR_URL_MAX - metarUrl.length() - 40; }
+
+    Stream *open(const String *stations, int hours, wx_response_t &resp);
+    bool close();
+
+private:
+    WiFiClientSecure secure_client;
+    WiFiClient plain_client;
+    WiFiClient *client;
+    HTTPClient http;
+    HttpBodyStream *body;
+    uint32_t connect_ms;
+    uint32_t request_start;
+};
+
+// if the server has closed our connection since last time, we reconnect
+// and try again.
+Stream *HttpSource::open(const String *stations, int hours, wx_response_t &resp)
+{
+    static const char *collect_headers[] = { "ETag", "Last-Modified", "Transfer-Encoding", "Content-Encoding", "Content-Type" };
+
+    String url;
+    if (stations == NULL) {
+        url = metarBulkUrl;
+    } else {
+        url = metarUrl;
+        url += "&hours=";
+        url += hours;
+        url += "&ids=";
+        url += *stations;
+    }
+    resp.status = WX_RESPONSE_FAILED;
+    resp.gzip = false;
+    resp.json = false;
+    resp.filtered = (stations == NULL);
+
+    client = url.startsWith("https:") ? &secure_client : &plain_client;
+    uint32_t hash = url_hash(url);
+    validator_t *v = find_validator(hash);
+
+    int rc = 0;
+    connect_ms = 0;
+    request_start = millis();
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool reused = client->connected();
+        uint32_t t = millis();
+        if (!reused) {
+            // no certificate checking; same as HTTPClient does for a bare https URL.
+            secure_client.setInsecure();
+            if (!connect_to(*client, url)) {
+                rc = HTTPC_ERROR_CONNECTION_REFUSED;
+                break;
+            }
+        }
+        connect_ms = millis() - t;
+
+        http.begin(*client, url);
+        http.setReuse(true);
+        http.collectHeaders(collect_headers, 5);
+        http.addHeader("Accept-Encoding", "gzip");
+        if (v != NULL) {
+            if (v->etag[0]) http.addHeader("If-None-Match", v->etag);
+            if (v->last_modified[0]) http.addHeader("If-Modified-Since", v->last_modified);
+        }
+
+        logInfo("Fetching %s (%s connection)\n", url.c_str(), reused ? "reused" : "new");
+        metar_stats.requests++;
+        request_start = millis();
+        rc = http.GET();
+        if (rc > 0 || !reused) break;
+        // the server closed our idle connection.  try once more, on a fresh one.
+        logInfo("METAR: reused connection failed (%d), reconnecting\n", rc);
+        http.end();
+        client->stop();
+    }
+    metar_stats.connect_ms += connect_ms;
+
+    if (rc <= 0) {
+        logError("HTTP GET %s: ERROR: %d %s\n", url.c_str(), rc, http.errorToString(rc).c_str() );
+        showMessagef(5000,"Error fetching METAR: %s", http.errorToString(rc).c_str());
+        http.end();
+        client->stop();
+        return NULL;
+    }
+    logDebug("HTTP GET %s: rc=%d size=%d\n", url.c_str(), rc, http.getSize());
+
+    // 1xx, 204 and 304 never have a body, whatever the headers say.  (with
+    // no length, HttpBodyStream would otherwise wait for the server to hang
+    // up, then drop the connection.)
+    bool bodiless = (rc < HTTP_CODE_OK || rc == HTTP_CODE_NO_CONTENT || rc == HTTP_CODE_NOT_MODIFIED);
+    bool chunked = !bodiless && http.header("Transfer-Encoding").equalsIgnoreCase("chunked");
+    body = new HttpBodyStream(client, bodiless ? 0 : http.getSize(), chunked);
+    if (rc == HTTP_CODE_NOT_MODIFIED) {
+        logInfo("METAR: not modified\n");
+        metar_stats.not_modified++;
+        resp.status = WX_RESPONSE_NOT_MODIFIED;
+        close();
+        return NULL;
+    }
+    if (rc == HTTP_CODE_NO_CONTENT) {
+        // the API's answer when none of the stations have anything new.
+        logInfo("METAR: no new reports\n");
+        resp.status = WX_RESPONSE_OK;
+        close();
+        return NULL;
+    }
+    if (rc != HTTP_CODE_OK) {
+        logError("HTTP GET %s: status %d\n", url.c_str(), rc);
+        showMessagef(5000, "Error fetching METAR: HTTP status %d", rc);
+        close();
+        return NULL;
+    }
+    save_validator(hash, http.header("ETag"), http.header("Last-Modified"));
+    resp.status = WX_RESPONSE_OK;
+    // the bulk file is a .gz file, rather than a gzip encoded response.
+    resp.gzip = http.header("Content-Encoding").equalsIgnoreCase("gzip") || url.endsWith(".gz");
+    resp.json = http.header("Content-Type").indexOf("json") >= 0;
+    return body;
+}
+
+bool HttpSource::close()
+{
+    if (body == NULL) return false;
+    // leave the connection at the start of the next response, or drop it.
+    bool reusable = body->drain();
+    bool ok = !body->error();
+    http.end();
+    if (!reusable) client->stop();
+    delete body;
+    body = NULL;
+
+    uint32_t request_ms = millis() - request_start;
+    metar_stats.request_ms += request_ms;
+    logInfo("METAR: connect %u ms, request %u ms\n", connect_ms, request_ms);
+    return ok;
+}
+
+WeatherSource *new_http_source()
+{
+    return new HttpSource();
+}
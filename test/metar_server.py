@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+# a stand-in for aviationweather.gov, for watching the conditional fetches
+# from a real board (see test/README.md).  it makes up an hourly METAR for
+# each station, issued at :53, and answers like the real API:
+#
+#   /api/data/metar?format=json&hours=N&ids=A,B,...
+#       every report in the last N hours, newest first, so each station
+#       comes back more than once.  204 if there are none.
+#   /data/cache/metars.cache.csv.gz
+#       the bulk file: the newest report for every station, as gzipped CSV.
+#
+# responses carry an ETag and Last-Modified, and a request that sends them
+# back gets a 304 until the next report is out.  connections are kept
+# alive, and JSON is gzipped if the client asks.  each request is logged
+# with its status and size, and the totals so far.
+#
+# usage: metar_server.py [-p port] [--minute] airports.csv | ID ...
+#
+# --minute makes the reports come out every minute instead of every hour,
+# so the 304s and new reports can be watched without waiting.
+import time, json, gzip, hashlib, argparse
+from email.utils import formatdate, parsedate_to_datetime
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import urlparse, parse_qs
+
+HEADER = ('raw_text,station_id,observation_time,latitude,longitude,temp_c,dewpoint_c,wind_dir_degrees,'
+          'wind_speed_kt,wind_gust_kt,visibility_statute_mi,altim_in_hg,sea_level_pressure_mb,corrected,auto,'
+          'auto_station,maintenance_indicator_on,no_signal,lightning_sensor_off,freezing_rain_sensor_off,'
+          'present_weather_sensor_off,wx_string,sky_cover,cloud_base_ft_agl,sky_cover,cloud_base_ft_agl,'
+          'sky_cover,cloud_base_ft_agl,sky_cover,cloud_base_ft_agl,flight_category,three_hr_pressure_tendency_mb,'
+          'maxT_c,minT_c,maxT24hr_c,minT24hr_c,precip_in,pcp3hr_in,pcp6hr_in,pcp24hr_in,snow_in,vert_vis_ft,'
+          'metar_type,elevation_m')
+
+# (flight category, visibility, cover, base) -- each station works its way
+# through these, an hour (or a minute) at a time.
+CONDITIONS = [('VFR', 10, 'FEW', 20000), ('MVFR', 5, 'BKN', 2500),
+              ('IFR', 2, 'OVC', 800), ('LIFR', 0.5, 'OVC', 200)]
+
+stations = []
+period = 3600
+totals = {'requests': 0, 'not_modified': 0, 'no_content': 0, 'bytes': 0}
+
+def read_stations(args):
+    if len(args) == 1 and args[0].endswith('.csv'):
+        with open(args[0]) as f:
+            f.readline()
+            ids = [line.split(',')[0] for line in f if line.strip()]
+        # KXXX=KYYY gets its weather from KYYY
+        return sorted(set(i.partition('=')[2] or i for i in ids))
+    return args
+
+# observation times for the reports issued in the last 'hours' hours, newest first.
+def report_times(now, hours):
+    t = now - now % period + (53 * period) // 60
+    if t > now:
+        t -= period
+    times = []
+    while t > now - hours * 3600 and len(times) < 48:
+        times.append(t)
+        t -= period
+    return times
+
+def report(station, i, obs):
+    cat, vis, cover, base = CONDITIONS[(sum(map(ord, station)) + obs // period) % len(CONDITIONS)]
+    tm = time.gmtime(obs)
+    raw = '%s %02d%02d%02dZ %03d%02dKT %sSM %s%03d 15/10 A2992' % (
+        station, tm.tm_mday, tm.tm_hour, tm.tm_min, (i * 40) % 360, 5 + i % 10,
+        ('%g' % vis) if vis >= 1 else '1/2', cover, base // 100)
+    return {'icaoId': station, 'obsTime': obs, 'temp': 15, 'dewp': 10, 'wdir': (i * 40) % 360,
+            'wspd': 5 + i % 10, 'wgst': None, 'visib': '10+' if vis >= 10 else vis, 'altim': 1013.2,
+            'metarType': 'METAR', 'rawOb': raw, 'clouds': [{'cover': cover, 'base': base}], 'fltCat': cat}
+
+def csv_row(r):
+    c = r['clouds'][0]
+    obs = time.strftime('%Y-%m-%dT%H:%M:%SZ', time.gmtime(r['obsTime']))
+    return ','.join([r['rawOb'], r['icaoId'], obs, '', '', '15.0', '10.0', str(r['wdir']), str(r['wspd']), '',
+                     str(r['visib']).rstrip('+'), '29.92', ''] + [''] * 9 +
+                    [c['cover'], str(c['base'])] + [''] * 6 + [r['fltCat']] + [''] * 11 + ['METAR', ''])
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'       # keep-alive, like the real server
+
+    def do_GET(self):
+        url = urlparse(self.path)
+        query = parse_qs(url.query)
+        now = int(time.time())
+        gz = False
+        if url.path == '/api/data/metar':
+            hours = int(query.get('hours', ['1'])[0])
+            ids = [i for i in query.get('ids', [''])[0].split(',') if i]
+            times = report_times(now, hours)
+            body = [report(s, stations.index(s) if s in stations else 0, t)
+                    for t in times for s in ids if s in stations]
+            body.sort(key=lambda r: (r['icaoId'], -r['obsTime']))
+            newest = times[0] if times else 0
+            body = json.dumps(body).encode() if body else b''
+            gz = 'gzip' in self.headers.get('Accept-Encoding', '')
+            kind = 'application/json'
+        elif url.path == '/data/cache/metars.cache.csv.gz':
+            newest = report_times(now, 1)[0]
+            rows = [csv_row(report(s, i, newest)) for i, s in enumerate(stations)]
+            text = 'No errors\nNo warnings\n1 ms\ndata source=metars\n%d results\n%s\n%s\n' % (
+                len(rows), HEADER, '\n'.join(rows))
+            body = gzip.compress(text.encode())
+            kind = 'application/x-gzip'
+        else:
+            self.send_error(404)
+            return
+
+        etag = '"%s"' % hashlib.md5(body).hexdigest()[:16]
+        last_modified = formatdate(newest, usegmt=True)
+        totals['requests'] += 1
+        since = self.headers.get('If-Modified-Since')
+        if self.headers.get('If-None-Match') == etag or (
+                since and newest and parsedate_to_datetime(since).timestamp() >= newest):
+            totals['not_modified'] += 1
+            self.send_response(304)
+            self.send_header('ETag', etag)
+            self.end_headers()
+            return
+        if not body:
+            totals['no_content'] += 1
+            self.send_response(204)
+            self.end_headers()
+            return
+        if gz:
+            body = gzip.compress(body)
+        totals['bytes'] += len(body)
+        self.send_response(200)
+        self.send_header('Content-Type', kind)
+        self.send_header('Content-Length', str(len(body)))
+        self.send_header('ETag', etag)
+        self.send_header('Last-Modified', last_modified)
+        if gz:
+            self.send_header('Content-Encoding', 'gzip')
+        self.end_headers()
+        self.wfile.write(body)
+
+    def log_request(self, code='-', size='-'):
+        self.log_message('"%s" %s  [%d requests, %d not modified, %d no content, %d bytes]', self.requestline,
+                         code, totals['requests'], totals['not_modified'], totals['no_content'], totals['bytes'])
+
+def main():
+    global stations, period
+    ap = argparse.ArgumentParser()
+    ap.add_argument('-p', '--port', type=int, default=8000)
+    ap.add_argument('--minute', action='store_true', help='a new report every minute, not every hour')
+    ap.add_argument('stations', nargs='+', help='airports.csv, or station ids')
+    args = ap.parse_args()
+    stations = read_stations(args.stations)
+    if args.minute:
+        period = 60
+    print('%d stations, on port %d' % (len(stations), args.port))
+    ThreadingHTTPServer(('', args.port), Handler).serve_forever()
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,47 @@
+#ifndef _H_TEST_ARDUINO_
+#define _H_TEST_ARDUINO_
+
+// just enough of Arduino (and FreeRTOS) to build the host side tests.
+// see test/README.md
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <chrono>
+#include <thread>
+
+static inline uint32_t micros()
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static inline uint32_t millis()
+{
+    return micros() / 1000;
+}
+
+static inline long random(long lo, long hi)
+{
+    return hi > lo ? lo + rand() % (hi - lo) : lo;
+}
+
+typedef uint32_t TickType_t;
+#define portMAX_DELAY ((TickType_t) 0xffffffff)
+#define portTICK_PERIOD_MS (1)
+static inline void vTaskDelay(uint32_t ticks)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+class Stream {
+public:
+    virtual ~Stream() {}
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual size_t readBytes(char *buffer, size_t length) = 0;
+};
+
+#endif // _H_TEST_ARDUINO_
@@ -0,0 +1,14 @@
+#ifndef _H_TEST_FASTLED_
+#define _H_TEST_FASTLED_
+
+// the bit of FastLED the LED effects use.  see test/README.md
+
+#include <stdint.h>
+
+struct CRGB {
+    uint8_t r, g, b;
+    CRGB() {}
+    CRGB(uint8_t r, uint8_t g, uint8_t b) : r(r), g(g), b(b) {}
+};
+
+#endif // _H_TEST_FASTLED_
@@ -0,0 +1,64 @@
+#ifndef _H_TEST_HOST_
+#define _H_TEST_HOST_
+
+// shared by the host side tests.  include it from exactly one file per
+// test (it defines the log functions).
+
+#include <Arduino.h>
+#include <stdarg.h>
+#include "log.h"
+
+// errors go to stderr; the rest would just bury the results.
+extern "C" {
+    int getLogLevel() { return LOG_ERROR; }
+    void setLogLevel(int lvl) {}
+    void logDebug(const char *fmt, ... ) {}
+    void logInfo(const char *fmt, ... ) {}
+    void logWarn(const char *fmt, ... ) {}
+    void logRaw(const char *fmt, ... ) {}
+    void logError(const char *fmt, ... )
+    {
+        va_list ap;
+        va_start(ap, fmt);
+        vfprintf(stderr, fmt, ap);
+        va_end(ap);
+    }
+}
+
+// nanoseconds since some point, for the benchmarks.
+static inline double bench_ns()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// the results of the benchmarks go to stdout, so 'pio test -v' shows them.
+#define BENCH(...) printf("BENCH: " __VA_ARGS__)
+
+// keeps the compiler from throwing away a benchmark's results.
+static volatile long bench_sink;
+
+// a Stream over a string, handing out at most 'chunk' bytes per read, so
+// a test can put rows across read boundaries.
+class TestStream : public Stream {
+public:
+    TestStream(const char *text, size_t chunk = 4096) : text(text), len(strlen(text)), pos(0), chunk(chunk) {}
+    int available() { return len - pos < chunk ? len - pos : chunk; }
+    int read() { return pos < len ? (uint8_t) text[pos++] : -1; }
+    int peek() { return pos < len ? (uint8_t) text[pos] : -1; }
+    size_t readBytes(char *buffer, size_t length)
+    {
+        size_t n = length;
+        if (n > chunk) n = chunk;
+        if (n > len - pos) n = len - pos;
+        memcpy(buffer, text + pos, n);
+        pos += n;
+        return n;
+    }
+
+private:
+    const char *text;
+    size_t len, pos, chunk;
+};
+
+#endif // _H_TEST_HOST_
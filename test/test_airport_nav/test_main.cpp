@@ -0,0 +1,135 @@
+// airport_nav: the precomputed neighbors against the scan over every
+// airport that _next_airport() used to do, on a hand made map and on
+// random clustered ones, and what a key press costs either way.
+#include <unity.h>
+#include <initializer_list>
+#include <vector>
+#include "test_host.h"
+#include "airport_nav.cpp"
+
+void setUp() {}
+void tearDown() {}
+
+// the old _next_airport() scan.
+static int scan_next(const airport_t *airports, int n, int from, int dir)
+{
+    const airport_t *cur = airports + from;
+    float xmult = (dir == NAV_UP || dir == NAV_DOWN) ? 2 : 1;
+    float ymult = (dir == NAV_LEFT || dir == NAV_RIGHT) ? 2 : 1;
+    float min_dist = FLT_MAX;
+    int best = -1;
+    for (int i = 0; i < n; i++) {
+        if (i == from || !in_direction(cur, airports + i, dir)) continue;
+        float dx = (airports[i].x - cur->x) * xmult;
+        float dy = (airports[i].y - cur->y) * ymult;
+        float dist = dx*dx + dy*dy;
+        if (dist < min_dist) {
+            min_dist = dist;
+            best = i;
+        }
+    }
+    return best;
+}
+
+static void set_pos(airport_t &ap, float x, float y)
+{
+    memset(&ap, 0, sizeof(ap));
+    ap.x = x;
+    ap.y = y;
+}
+
+//      0
+//   1  2  3
+//      4     5
+static void test_small_map()
+{
+    static airport_t map[6];
+    set_pos(map[0], 10, 0);
+    set_pos(map[1], 0, 10);
+    set_pos(map[2], 10, 10);
+    set_pos(map[3], 20, 10);
+    set_pos(map[4], 10, 20);
+    set_pos(map[5], 30, 20);
+    TEST_ASSERT_TRUE(nav_begin(map, 6));
+
+    TEST_ASSERT_EQUAL_INT(0, nav_next(2, NAV_UP));
+    TEST_ASSERT_EQUAL_INT(4, nav_next(2, NAV_DOWN));
+    TEST_ASSERT_EQUAL_INT(1, nav_next(2, NAV_LEFT));
+    TEST_ASSERT_EQUAL_INT(3, nav_next(2, NAV_RIGHT));
+    // 0, 1, 3 and 4 are all 10 away: the lowest index wins.
+    TEST_ASSERT_EQUAL_INT(0, nav_next(2, NAV_ANY));
+    // nothing above the top one.
+    TEST_ASSERT_EQUAL_INT(-1, nav_next(0, NAV_UP));
+    // 3 is above and to the left of 5, but going left, up/down only costs double.
+    TEST_ASSERT_EQUAL_INT(4, nav_next(5, NAV_LEFT));
+    TEST_ASSERT_EQUAL_INT(-1, nav_next(5, NAV_RIGHT));
+    TEST_ASSERT_EQUAL_INT(-1, nav_next(6, NAV_UP));
+    TEST_ASSERT_EQUAL_INT(-1, nav_next(2, NAV_DIRS));
+}
+
+// clusters of airports (like cities on a map), plus some loners.
+static std::vector<airport_t> random_map(int n)
+{
+    std::vector<airport_t> map(n);
+    int clusters = n / 20 + 1;
+    std::vector<float> cx(clusters), cy(clusters);
+    for (int c = 0; c < clusters; c++) {
+        cx[c] = random(0, 1000);
+        cy[c] = random(0, 600);
+    }
+    for (int i = 0; i < n; i++) {
+        if (i % 5 == 0) {
+            set_pos(map[i], random(0, 1000), random(0, 600));
+        } else {
+            int c = i % clusters;
+            set_pos(map[i], cx[c] + random(-30, 30), cy[c] + random(-30, 30));
+        }
+    }
+    return map;
+}
+
+static void test_matches_scan()
+{
+    srand(1);
+    for (int n : { 1, 2, 10, 100, 500 }) {
+        std::vector<airport_t> map = random_map(n);
+        TEST_ASSERT_TRUE(nav_begin(map.data(), n));
+        int mismatches = 0;
+        for (int i = 0; i < n; i++) {
+            for (int dir = 0; dir < NAV_DIRS; dir++) {
+                if (nav_next(i, dir) != scan_next(map.data(), n, i, dir)) mismatches++;
+            }
+        }
+        TEST_ASSERT_EQUAL_INT(0, mismatches);
+    }
+}
+
+static void bench_next()
+{
+    srand(2);
+    for (int n : { 100, 500, 2000, 5000 }) {
+        std::vector<airport_t> map = random_map(n);
+        double t = bench_ns();
+        nav_begin(map.data(), n);
+        double build = (bench_ns() - t) / 1e6;
+
+        int presses = 2000000 / n;
+        t = bench_ns();
+        for (int k = 0; k < presses; k++) bench_sink += scan_next(map.data(), n, (int)((k * 7919LL) % n), k % NAV_DIRS);
+        double scan = (bench_ns() - t) / presses;
+        presses = 2000000;
+        t = bench_ns();
+        for (int k = 0; k < presses; k++) bench_sink += nav_next((int)((k * 7919LL) % n), k % NAV_DIRS);
+        double lookup = (bench_ns() - t) / presses;
+        BENCH("key press, %d airports: scan %.0f ns, lookup %.1f ns (build %.1f ms)\n", n, scan, lookup, build);
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_small_map);
+    RUN_TEST(test_matches_scan);
+    RUN_TEST(bench_next);
+    return UNITY_END();
+}
@@ -0,0 +1,132 @@
+// CSVReader: rows and fields, rows across read boundaries, and parse
+// throughput against the old readStringUntil()/substring() loop.
+#include <unity.h>
+#include <string>
+#include "test_host.h"
+#include "csv_reader.cpp"
+
+void setUp() {}
+void tearDown() {}
+
+static void test_fields()
+{
+    TestStream in("a,bb,,ccc\n1,2,3\n");
+    CSVReader csv(&in);
+    TEST_ASSERT_EQUAL_INT(4, csv.readRow());
+    TEST_ASSERT_EQUAL_STRING("bb", csv.field(1));
+    TEST_ASSERT_EQUAL_INT(2, csv.fieldLen(1));
+    TEST_ASSERT_EQUAL_STRING("", csv.field(2));
+    TEST_ASSERT_EQUAL_STRING("ccc", csv.field(3));
+    TEST_ASSERT_EQUAL_STRING("", csv.field(4));
+    TEST_ASSERT_EQUAL_INT(3, csv.readRow());
+    TEST_ASSERT_EQUAL_STRING("3", csv.field(2));
+    TEST_ASSERT_EQUAL_INT(-1, csv.readRow());
+}
+
+static void test_crlf_and_no_trailing_newline()
+{
+    TestStream in("x,y\r\nlast,row");
+    CSVReader csv(&in);
+    TEST_ASSERT_EQUAL_INT(2, csv.readRow());
+    TEST_ASSERT_EQUAL_STRING("y", csv.field(1));
+    TEST_ASSERT_EQUAL_INT(2, csv.readRow());
+    TEST_ASSERT_EQUAL_STRING("row", csv.field(1));
+    TEST_ASSERT_EQUAL_INT(-1, csv.readRow());
+}
+
+// every read is short, so every row spans several of them.
+static void test_rows_across_reads()
+{
+    std::string text;
+    for (int i = 0; i < 200; i++) text += "KSJC,KSJC 182347Z 16012KT 10SM FEW200 21/06 A2994," + std::to_string(i) + "\n";
+    for (size_t chunk : { 1, 7, 64, 1000 }) {
+        TestStream in(text.c_str(), chunk);
+        CSVReader csv(&in);
+        for (int i = 0; i < 200; i++) {
+            TEST_ASSERT_EQUAL_INT(3, csv.readRow());
+            TEST_ASSERT_EQUAL_STRING("KSJC", csv.field(0));
+            TEST_ASSERT_EQUAL_STRING(std::to_string(i).c_str(), csv.field(2));
+        }
+        TEST_ASSERT_EQUAL_INT(-1, csv.readRow());
+        TEST_ASSERT_EQUAL_INT(text.size(), csv.bytesRead());
+    }
+}
+
+// a row longer than the buffer is dropped (as a blank row), and the next one is fine.
+static void test_oversized_row()
+{
+    std::string text = "a,b\n" + std::string(CSV_BUFFER_SIZE * 2, 'x') + "\nc,d\n";
+    TestStream in(text.c_str(), 100);
+    CSVReader csv(&in);
+    TEST_ASSERT_EQUAL_INT(2, csv.readRow());
+    TEST_ASSERT_EQUAL_INT(0, csv.readRow());
+    TEST_ASSERT_EQUAL_INT(2, csv.readRow());
+    TEST_ASSERT_EQUAL_STRING("d", csv.field(1));
+}
+
+// METAR rows in the shape of the ADDS CSV (44 columns).
+static std::string metar_csv(int rows)
+{
+    std::string text;
+    for (int i = 0; i < rows; i++) {
+        text += "KSJC 182347Z 16012KT 10SM FEW200 21/06 A2994 RMK AO2 SLP137 T02110061,KSJC,"
+            "2023-03-18T23:47:00Z,37.33,-121.82,21.1,6.1,160,12,,10.0,29.940945,1013.7,,,,,,,,,"
+            "FEW,20000,,,,,,,VFR,,,,,,,,,,,,METAR,37.0\n";
+    }
+    return text;
+}
+
+// what update_airport_wx() used to do: readStringUntil() a byte at a
+// time, then a String (here std::string) per cell.
+static int old_parse(Stream &in)
+{
+    int cells = 0;
+    std::string vals[64];
+    while (in.peek() >= 0) {
+        std::string row;
+        int c;
+        while ((c = in.read()) >= 0 && c != '\n') row += (char) c;
+        int start = 0, len = row.size(), col = 0;
+        while (start < len && col < 64) {
+            int end = row.find(',', start);
+            if (end < 0) end = len;
+            vals[col++] = row.substr(start, end - start);
+            start = end + 1;
+        }
+        cells += col;
+    }
+    return cells;
+}
+
+static int new_parse(Stream &in)
+{
+    int cells = 0, n;
+    CSVReader csv(&in);
+    while ((n = csv.readRow()) >= 0) cells += n;
+    return cells;
+}
+
+static void bench_parse()
+{
+    std::string text = metar_csv(2000);
+    double mb = text.size() / 1e6;
+    for (int pass = 0; pass < 2; pass++) {
+        TestStream in(text.c_str(), 1460);      // about a TCP segment per read
+        double t = bench_ns();
+        int cells = pass ? new_parse(in) : old_parse(in);
+        t = (bench_ns() - t) / 1e9;
+        bench_sink += cells;
+        BENCH("csv %s: %d rows, %.1f MB/s\n", pass ? "CSVReader" : "readStringUntil+substring", 2000, mb / t);
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_fields);
+    RUN_TEST(test_crlf_and_no_trailing_newline);
+    RUN_TEST(test_rows_across_reads);
+    RUN_TEST(test_oversized_row);
+    RUN_TEST(bench_parse);
+    return UNITY_END();
+}
@@ -0,0 +1,122 @@
+// kv_map: every key found, misses return 'missing', the same answers as
+// the NULL terminated scan match_kv() used to do, and lookup cost against
+// it.  the tables are the ones the firmware ships, from metar_fields.cpp.
+#include <unity.h>
+#include <initializer_list>
+#include <vector>
+#include "test_host.h"
+#include "metar_fields.cpp"
+#include "csv_reader.cpp"
+#include "wx_flags.cpp"
+#include "arena.cpp"
+
+void setUp() {}
+void tearDown() {}
+
+// the old match_kv(): a kv_pair list ending in { NULL, missing }.
+template <typename T>
+static T scan_kv(const kv_pair<T> *kv, const char *key)
+{
+    while (kv->key != NULL) {
+        if (strcmp(key, kv->key) == 0) break;
+        kv++;
+    }
+    return kv->val;
+}
+
+// a shipped table as the old NULL terminated list.
+template <typename T, size_t N>
+static std::vector<kv_pair<T>> scan_list(const kv_pair<T> (&kv)[N], T missing)
+{
+    std::vector<kv_pair<T>> list(kv, kv + N);
+    list.push_back({ NULL, missing });
+    return list;
+}
+
+static const std::vector<kv_pair<int>> sky_cover_list = scan_list(sky_cover_kv, CLOUD_INVALID);
+static const std::vector<kv_pair<int>> flight_category_list = scan_list(flight_category_kv, -1);
+static const std::vector<kv_pair<field_setter>> metar_fields_list = scan_list(metar_fields_kv, (field_setter) NULL);
+
+// what actually gets looked up: values from real reports, and the
+// columns of the ADDS CSV header, most of which we don't use.
+static const char *sky_cover_inputs[] = {
+    "FEW", "SCT", "BKN", "OVC", "CLR", "SKC", "OVX", "CAVOK", "", "FEW", "BKN", "OVC",
+    "SCT", "CLR", "NSC", "OVC",
+};
+static const char *flight_category_inputs[] = {
+    "VFR", "VFR", "MVFR", "IFR", "VFR", "LIFR", "", "VFR", "MVFR", "VFR",
+};
+static const char *metar_field_inputs[] = {
+    "raw_text", "station_id", "observation_time", "latitude", "longitude", "temp_c",
+    "dewpoint_c", "wind_dir_degrees", "wind_speed_kt", "wind_gust_kt",
+    "visibility_statute_mi", "altim_in_hg", "sea_level_pressure_mb", "corrected", "auto",
+    "auto_station", "maintenance_indicator_on", "no_signal", "lightning_sensor_off",
+    "freezing_rain_sensor_off", "present_weather_sensor_off", "wx_string", "sky_cover",
+    "cloud_base_ft_agl", "sky_cover", "cloud_base_ft_agl", "sky_cover", "cloud_base_ft_agl",
+    "sky_cover", "cloud_base_ft_agl", "flight_category", "three_hr_pressure_tendency_mb",
+    "maxT_c", "minT_c", "maxT24hr_c", "minT24hr_c", "precip_in", "pcp3hr_in", "pcp6hr_in",
+    "pcp24hr_in", "snow_in", "vert_vis_ft", "metar_type", "elevation_m",
+};
+
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+static void test_every_key()
+{
+    for (const kv_pair<int> &kv : sky_cover_kv) TEST_ASSERT_EQUAL_INT(kv.val, match_kv(sky_cover_map, kv.key));
+    for (const kv_pair<int> &kv : flight_category_kv) TEST_ASSERT_EQUAL_INT(kv.val, match_kv(flight_category_map, kv.key));
+    for (const kv_pair<field_setter> &kv : metar_fields_kv) TEST_ASSERT_TRUE(kv.val == match_kv(metar_fields, kv.key));
+}
+
+// prefixes, extensions, case, and empty strings are all misses.
+static void test_misses()
+{
+    for (const char *key : { "", "V", "VF", "VFRX", "vfr", "MVF", "LIFR ", "SKC" }) {
+        TEST_ASSERT_EQUAL_INT(-1, match_kv(flight_category_map, key));
+    }
+    for (const char *key : { "", "sky", "sky_cover_2", "SKY_COVER", "station_id" }) {
+        TEST_ASSERT_NULL(match_kv(metar_fields, key));
+    }
+}
+
+static void test_matches_scan()
+{
+    for (const char *key : sky_cover_inputs) TEST_ASSERT_EQUAL_INT(scan_kv(sky_cover_list.data(), key), match_kv(sky_cover_map, key));
+    for (const char *key : flight_category_inputs) TEST_ASSERT_EQUAL_INT(scan_kv(flight_category_list.data(), key), match_kv(flight_category_map, key));
+    for (const char *key : metar_field_inputs) TEST_ASSERT_TRUE(scan_kv(metar_fields_list.data(), key) == match_kv(metar_fields, key));
+}
+
+template <typename T, size_t N>
+static void bench_table(const char *name, const kv_map<T, N> &map, const std::vector<kv_pair<T>> &table, const char **inputs, int n)
+{
+    const kv_pair<T> *list = table.data();
+    T missing = table.back().val;
+    int rounds = 2000000 / n;
+    double t = bench_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < n; i++) bench_sink += scan_kv(list, inputs[i]) != missing;
+    }
+    double scan = (bench_ns() - t) / ((double) rounds * n);
+    t = bench_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < n; i++) bench_sink += match_kv(map, inputs[i]) != missing;
+    }
+    double hashed = (bench_ns() - t) / ((double) rounds * n);
+    BENCH("%s: scan %.1f ns, perfect hash %.1f ns\n", name, scan, hashed);
+}
+
+static void bench_lookup()
+{
+    bench_table("sky_cover_map", sky_cover_map, sky_cover_list, sky_cover_inputs, COUNT(sky_cover_inputs));
+    bench_table("flight_category_map", flight_category_map, flight_category_list, flight_category_inputs, COUNT(flight_category_inputs));
+    bench_table("metar_fields", metar_fields, metar_fields_list, metar_field_inputs, COUNT(metar_field_inputs));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_every_key);
+    RUN_TEST(test_misses);
+    RUN_TEST(test_matches_scan);
+    RUN_TEST(bench_lookup);
+    return UNITY_END();
+}
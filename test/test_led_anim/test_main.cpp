@@ -0,0 +1,213 @@
+// led_anim: the blink's, pulse's and strobe's timing, the cross-fade
+// running once and stopping itself, starting and stopping effects in the
+// pool, when anim_frame() reports a change, and the cost of a frame with
+// every LED running an effect.
+#include <unity.h>
+#include <initializer_list>
+#include "test_host.h"
+#include "led_anim.cpp"
+
+#define NUM_LEDS (8)
+
+static const CRGB white(255, 255, 255);
+static CRGB leds[NUM_LEDS];
+
+// the effects draw over the base colors, so put those back each frame.
+static bool frame(int elapsed)
+{
+    for (int i = 0; i < NUM_LEDS; i++) leds[i] = CRGB(0, 0, 0);
+    return anim_frame(leds, elapsed);
+}
+
+void setUp()
+{
+    anim_begin(NUM_LEDS);
+    // use up the change left over from the last test's stops.
+    frame(0);
+}
+
+void tearDown()
+{
+    free(pool);
+    free(slot);
+}
+
+// 250 ms on, 250 ms off, over and over.
+static void test_blink()
+{
+    anim_start(1, ANIM_BLINK, white);
+    frame(0);
+    TEST_ASSERT_EQUAL_UINT8(255, leds[1].r);
+    for (int t = 10; t < 2000; t += 10) {
+        frame(10);
+        TEST_ASSERT_EQUAL_UINT8(t % 500 < 250 ? 255 : 0, leds[1].r);
+        TEST_ASSERT_EQUAL_UINT8(0, leds[0].r);
+        TEST_ASSERT_EQUAL_UINT8(0, leds[2].r);
+    }
+}
+
+// up to 160 at 1 s, back down at 2 s, and around again with no gap.
+static void test_pulse()
+{
+    anim_start(2, ANIM_PULSE, white);
+    frame(0);
+    TEST_ASSERT_EQUAL_UINT8(0, leds[2].r);
+    frame(500);
+    TEST_ASSERT_EQUAL_UINT8(80, leds[2].r);
+    frame(500);
+    TEST_ASSERT_EQUAL_UINT8(160, leds[2].r);
+    frame(1000);
+    TEST_ASSERT_EQUAL_UINT8(0, leds[2].r);
+    frame(1000);
+    TEST_ASSERT_EQUAL_UINT8(160, leds[2].r);
+    TEST_ASSERT_EQUAL_INT(ANIM_PULSE, anim_effect(2));
+}
+
+// 50 ms on, once a second.
+static void test_strobe()
+{
+    anim_start(4, ANIM_STROBE, white);
+    for (int t = 0; t < 3000; t += 10) {
+        frame(t ? 10 : 0);
+        TEST_ASSERT_EQUAL_UINT8(t % 1000 < 50 ? 255 : 0, leds[4].r);
+    }
+}
+
+// from the color to the LED's own in 500 ms, then it's gone (and that's a change).
+static void test_crossfade()
+{
+    anim_start(5, ANIM_CROSSFADE, white);
+    TEST_ASSERT_TRUE(frame(0));
+    TEST_ASSERT_EQUAL_UINT8(255, leds[5].r);
+    frame(250);
+    TEST_ASSERT_EQUAL_UINT8(128, leds[5].r);
+    frame(240);
+    TEST_ASSERT_TRUE(leds[5].r > 0 && leds[5].r < 10);
+    TEST_ASSERT_EQUAL_INT(ANIM_CROSSFADE, anim_effect(5));
+    TEST_ASSERT_TRUE(frame(10));
+    TEST_ASSERT_EQUAL_UINT8(0, leds[5].r);
+    TEST_ASSERT_EQUAL_INT(ANIM_NONE, anim_effect(5));
+    TEST_ASSERT_EQUAL_INT(0, anim_count());
+    TEST_ASSERT_FALSE(frame(33));
+}
+
+// one ending moves the last one into its place, and that one still runs
+// in the same frame.
+static void test_crossfade_ends_in_pool()
+{
+    anim_start(0, ANIM_CROSSFADE, white);
+    anim_start(1, ANIM_BLINK, white);
+    anim_start(2, ANIM_CROSSFADE, white);
+    anim_start(3, ANIM_BLINK, white);
+    frame(0);
+    frame(600);
+    TEST_ASSERT_EQUAL_INT(2, anim_count());
+    TEST_ASSERT_EQUAL_INT(ANIM_NONE, anim_effect(0));
+    TEST_ASSERT_EQUAL_INT(ANIM_NONE, anim_effect(2));
+    // 600 ms into the blink: on.
+    TEST_ASSERT_EQUAL_UINT8(255, leds[1].r);
+    TEST_ASSERT_EQUAL_UINT8(255, leds[3].r);
+    TEST_ASSERT_EQUAL_UINT8(0, leds[0].r);
+    TEST_ASSERT_EQUAL_UINT8(0, leds[2].r);
+}
+
+// starting what's already running doesn't restart it; anything else replaces it.
+static void test_start()
+{
+    anim_start(3, ANIM_BLINK, white);
+    frame(200);
+    anim_start(3, ANIM_BLINK, white);
+    frame(100);
+    TEST_ASSERT_EQUAL_UINT8(0, leds[3].r);
+    anim_start(3, ANIM_GUST, white);
+    TEST_ASSERT_EQUAL_INT(ANIM_GUST, anim_effect(3));
+    TEST_ASSERT_EQUAL_INT(1, anim_count());
+
+    anim_start(-1, ANIM_BLINK, white);
+    anim_start(NUM_LEDS, ANIM_BLINK, white);
+    anim_start(4, ANIM_NONE, white);
+    anim_start(4, ANIM_EFFECTS, white);
+    TEST_ASSERT_EQUAL_INT(1, anim_count());
+    TEST_ASSERT_EQUAL_INT(ANIM_NONE, anim_effect(4));
+}
+
+// stopping one moves the last one into its place; the others carry on.
+static void test_stop()
+{
+    anim_start(0, ANIM_BLINK, white);
+    anim_start(5, ANIM_GUST, white);
+    anim_start(6, ANIM_LIGHTNING, white);
+    anim_start(7, ANIM_BLINK, white);
+    anim_stop(0);
+    anim_stop(0);
+    TEST_ASSERT_EQUAL_INT(3, anim_count());
+    TEST_ASSERT_EQUAL_INT(ANIM_NONE, anim_effect(0));
+    TEST_ASSERT_EQUAL_INT(ANIM_GUST, anim_effect(5));
+    TEST_ASSERT_EQUAL_INT(ANIM_LIGHTNING, anim_effect(6));
+    TEST_ASSERT_EQUAL_INT(ANIM_BLINK, anim_effect(7));
+    frame(100);
+    TEST_ASSERT_EQUAL_UINT8(0, leds[0].r);
+    TEST_ASSERT_EQUAL_UINT8(255, leds[7].r);
+
+    anim_stop(7);
+    anim_stop(5);
+    anim_stop(6);
+    TEST_ASSERT_EQUAL_INT(0, anim_count());
+}
+
+static void test_changed()
+{
+    TEST_ASSERT_FALSE(frame(33));
+    anim_start(2, ANIM_BLINK, white);
+    TEST_ASSERT_TRUE(frame(0));
+    // still on
+    TEST_ASSERT_FALSE(frame(100));
+    TEST_ASSERT_FALSE(frame(100));
+    // off
+    TEST_ASSERT_TRUE(frame(100));
+    TEST_ASSERT_FALSE(frame(100));
+    anim_stop(2);
+    TEST_ASSERT_TRUE(frame(33));
+    TEST_ASSERT_FALSE(frame(33));
+}
+
+static void bench_frame()
+{
+    for (int n : { 100, 500, 2000, 5000 }) {
+        anim_t *saved_pool = pool;
+        int16_t *saved_slot = slot;
+        anim_begin(n);
+        CRGB *big = (CRGB*) calloc(n, sizeof(CRGB));
+        // everything that loops (a cross-fade would stop part way through)
+        for (int i = 0; i < n; i++) anim_start(i, ANIM_PULSE + i % (ANIM_CROSSFADE - ANIM_PULSE), white);
+
+        int frames = 20000000 / n;
+        double t = bench_ns();
+        for (int f = 0; f < frames; f++) bench_sink += anim_frame(big, 33);
+        double per = (bench_ns() - t) / frames;
+        BENCH("anim_frame, %d LEDs all animating: %.2f us per frame (%.1f ns per LED)\n", n, per / 1000, per / n);
+
+        free(big);
+        free(pool);
+        free(slot);
+        pool = saved_pool;
+        slot = saved_slot;
+    }
+    num_leds = NUM_LEDS;
+    num_anims = 0;
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_blink);
+    RUN_TEST(test_pulse);
+    RUN_TEST(test_strobe);
+    RUN_TEST(test_crossfade);
+    RUN_TEST(test_crossfade_ends_in_pool);
+    RUN_TEST(test_start);
+    RUN_TEST(test_stop);
+    RUN_TEST(test_changed);
+    RUN_TEST(bench_frame);
+    return UNITY_END();
+}
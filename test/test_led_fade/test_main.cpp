@@ -0,0 +1,114 @@
+// led_fade: fades land exactly on their target, in a bounded number of
+// frames, and fade_toward() reports when nothing moved.  the benchmark is
+// against the INT_LERP(..., 0.2) per channel it replaced.
+#include <unity.h>
+#include <vector>
+#include "test_host.h"
+#include "led_fade.cpp"
+
+#define INT_LERP(a, b, t) (int)( (((b)-(a)) * (t)) + (a) )
+
+void setUp() {}
+void tearDown() {}
+
+// frames for fade_step() to get from 'from' to 'to', or -1 if it never does.
+static int frames_to_land(int from, int to, int rate)
+{
+    int cur = from;
+    for (int frames = 0; frames < 1000; frames++) {
+        if (cur == to) return frames;
+        cur = fade_step(cur, to, rate);
+    }
+    return -1;
+}
+
+// every pair of byte values, both rates.  at 30 fps, 21 frames is 0.7 s.
+static void test_step_lands()
+{
+    int worst_leds = 0, worst_brightness = 0;
+    for (int from = 0; from < 256; from++) {
+        for (int to = 0; to < 256; to++) {
+            int f = frames_to_land(from, to, FADE_RATE_LEDS);
+            TEST_ASSERT_TRUE(f >= 0);
+            if (f > worst_leds) worst_leds = f;
+            f = frames_to_land(from, to, FADE_RATE_BRIGHTNESS);
+            TEST_ASSERT_TRUE(f >= 0);
+            if (f > worst_brightness) worst_brightness = f;
+        }
+    }
+    TEST_ASSERT_EQUAL_INT(21, worst_leds);
+    TEST_ASSERT_EQUAL_INT(36, worst_brightness);
+}
+
+// the brightness fades in 8.8 fixed point.
+static void test_step_lands_16bit()
+{
+    for (int from = 0; from < 65536; from += 257) {
+        for (int to = 0; to < 65536; to += 255) {
+            int f = frames_to_land(from, to, FADE_RATE_BRIGHTNESS);
+            TEST_ASSERT_TRUE(f >= 0 && f <= 90);
+        }
+    }
+}
+
+// the old fade truncated toward where it came from, so it stopped short.
+static void test_int_lerp_stalls()
+{
+    int cur = 0;
+    for (int frames = 0; frames < 100; frames++) cur = INT_LERP(cur, 255, 0.2);
+    TEST_ASSERT_EQUAL_INT(251, cur);
+    cur = 0;
+    for (int frames = 0; frames < 100; frames++) cur = fade_step(cur, 255, FADE_RATE_LEDS);
+    TEST_ASSERT_EQUAL_INT(255, cur);
+}
+
+static void test_toward()
+{
+    uint8_t cur[6] = { 0, 10, 255, 7, 7, 7 };
+    const uint8_t target[6] = { 255, 10, 0, 7, 7, 8 };
+    TEST_ASSERT_EQUAL_INT(3, fade_toward(cur, target, 6, FADE_RATE_LEDS));
+    TEST_ASSERT_EQUAL_UINT8(51, cur[0]);
+    TEST_ASSERT_EQUAL_UINT8(204, cur[2]);
+    TEST_ASSERT_EQUAL_UINT8(8, cur[5]);
+    int frames = 1;
+    while (fade_toward(cur, target, 6, FADE_RATE_LEDS) > 0) frames++;
+    TEST_ASSERT_EQUAL_MEMORY(target, cur, 6);
+    TEST_ASSERT_TRUE(frames <= 21);
+    TEST_ASSERT_EQUAL_INT(0, fade_toward(cur, target, 6, FADE_RATE_LEDS));
+}
+
+static void bench_fade()
+{
+    for (int n : { 100, 500, 2000 }) {
+        int bytes = n * 3;
+        std::vector<uint8_t> cur(bytes), target(bytes);
+        int frames = 20000000 / bytes;
+
+        // restart the fades every 32 frames, so most frames have work to do.
+        double t = bench_ns();
+        for (int f = 0; f < frames; f++) {
+            if ((f & 31) == 0) for (int i = 0; i < bytes; i++) target[i] = (i * 37 + f) & 0xff;
+            for (int i = 0; i < bytes; i++) cur[i] = INT_LERP(cur[i], target[i], 0.2);
+            bench_sink += cur[f % bytes];
+        }
+        double lerp = (bench_ns() - t) / frames;
+        t = bench_ns();
+        for (int f = 0; f < frames; f++) {
+            if ((f & 31) == 0) for (int i = 0; i < bytes; i++) target[i] = (i * 37 + f) & 0xff;
+            bench_sink += fade_toward(cur.data(), target.data(), bytes, FADE_RATE_LEDS);
+        }
+        double step = (bench_ns() - t) / frames;
+        BENCH("fade, %d LEDs: INT_LERP %.0f ns, fade_toward %.0f ns per frame\n", n, lerp, step);
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_step_lands);
+    RUN_TEST(test_step_lands_16bit);
+    RUN_TEST(test_int_lerp_stalls);
+    RUN_TEST(test_toward);
+    RUN_TEST(bench_fade);
+    return UNITY_END();
+}
@@ -0,0 +1,404 @@
+// the parse task's half of a fetch: a response replayed through parse_wx()
+// and parse_wx_json() in network sized pieces, the staged records checked,
+// and the parse throughput of a bulk sized response.
+#include <unity.h>
+#include <string>
+#include <initializer_list>
+#include "test_host.h"
+#include "metar_parse.cpp"
+#include "metar_fields.cpp"
+#include "csv_reader.cpp"
+#include "wx_flags.cpp"
+#include "arena.cpp"
+#include "wx_schedule.cpp"
+#include "station_index.cpp"
+
+// the map: what metar.cpp and airports.cpp would have set up.
+metar_stats_t metar_stats;
+static const char *map_stations[] = { "KSJC", "KSFO", "KOAK", "KHWD" };
+#define NUM_MAP_STATIONS (4)
+static station_index_t wx_index;
+int num_airports;
+
+// bulk responses have every station the server has; BENCH_MAP_STATIONS of
+// them are on the map too (M000, M001, ...)
+#define BENCH_MAP_STATIONS (40)
+static char bench_ids[BENCH_MAP_STATIONS][8];
+
+int station_airport_index(const char *station, int len, int &iter)
+{
+    return station_index_find(wx_index, station, len, iter);
+}
+
+// the ADDS CSV response, as it comes back for ids=KSJC,KSFO,KOAK,KSQL:
+// preamble, header, and one row per station (KSQL isn't on the map).
+static const char *adds_csv =
+    "No errors\n"
+    "No warnings\n"
+    "14 ms\n"
+    "data source=metars\n"
+    "4 results\n"
+    "raw_text,station_id,observation_time,latitude,longitude,temp_c,dewpoint_c,wind_dir_degrees,wind_speed_kt,"
+    "wind_gust_kt,visibility_statute_mi,altim_in_hg,sea_level_pressure_mb,corrected,auto,auto_station,"
+    "maintenance_indicator_on,no_signal,lightning_sensor_off,freezing_rain_sensor_off,present_weather_sensor_off,"
+    "wx_string,sky_cover,cloud_base_ft_agl,sky_cover,cloud_base_ft_agl,sky_cover,cloud_base_ft_agl,sky_cover,"
+    "cloud_base_ft_agl,flight_category,three_hr_pressure_tendency_mb,maxT_c,minT_c,maxT24hr_c,minT24hr_c,"
+    "precip_in,pcp3hr_in,pcp6hr_in,pcp24hr_in,snow_in,vert_vis_ft,metar_type,elevation_m\n"
+    "KSJC 182347Z 16012KT 10SM FEW200 21/06 A2994 RMK AO2 SLP137 T02110061,KSJC,2023-03-18T23:47:00Z,"
+    "37.37,-121.93,21.1,6.1,160,12,,10.0,29.940945,1013.7,,,TRUE,,,,,,,FEW,20000,,,,,,,VFR,,,,,,,,,,,,METAR,16.0\n"
+    "KSFO 182356Z 29008G18KT 2SM -TSRA BR BKN008 OVC015 12/11 A2990 RMK AO2 LTG DSNT W,KSFO,2023-03-18T23:56:00Z,"
+    "37.62,-122.37,12.0,11.0,290,8,18,2.0,29.899607,1012.4,,,TRUE,,,,,,-TSRA BR,BKN,800,OVC,1500,,,,,IFR,,,,,,,,,,,,METAR,3.0\n"
+    "KSQL 182347Z 32006KT 10SM CLR 20/07 A2993,KSQL,2023-03-18T23:47:00Z,"
+    "37.51,-122.25,20.0,7.0,320,6,,10.0,29.929134,,,,,,,,,,,CLR,,,,,,,,VFR,,,,,,,,,,,,METAR,2.0\n"
+    "KOAK 190005Z 00000KT 1/4SM FG VV002 10/10 A2991,KOAK,2023-03-19T00:05:00Z,"
+    "37.72,-122.22,10.0,10.0,0,0,,0.25,29.910236,,,,,,,,,,FG,OVX,200,,,,,,,LIFR,,,,,,,,,,,200,SPECI,3.0\n";
+
+// the same stations from the JSON API (format=json), with some of the keys
+// the filter drops.
+static const char *api_json =
+    "[{\"icaoId\":\"KSJC\",\"receiptTime\":\"2023-03-18 23:50:12\",\"obsTime\":1679183220,\"reportTime\":\"2023-03-19 00:00:00\","
+    "\"temp\":21.1,\"dewp\":6.1,\"wdir\":160,\"wspd\":12,\"wgst\":null,\"visib\":\"10+\",\"altim\":1013.9,\"slp\":1013.7,"
+    "\"qcField\":4,\"wxString\":null,\"metarType\":\"METAR\",\"rawOb\":\"KSJC 182347Z 16012KT 10SM FEW200 21/06 A2994 RMK AO2 SLP137 T02110061\","
+    "\"lat\":37.37,\"lon\":-121.93,\"elev\":16,\"name\":\"San Jose Intl, CA, US\",\"clouds\":[{\"cover\":\"FEW\",\"base\":20000}],\"fltCat\":\"VFR\"},\n"
+    "{\"icaoId\":\"KSFO\",\"obsTime\":1679183760,\"temp\":12,\"dewp\":11,\"wdir\":290,\"wspd\":8,\"wgst\":18,\"visib\":2,\"altim\":1012.5,"
+    "\"wxString\":\"-TSRA BR\",\"metarType\":\"METAR\",\"rawOb\":\"KSFO 182356Z 29008G18KT 2SM -TSRA BR BKN008 OVC015 12/11 A2990 RMK AO2 LTG DSNT W\","
+    "\"name\":\"San Francisco Intl, CA, US\",\"clouds\":[{\"cover\":\"BKN\",\"base\":800},{\"cover\":\"OVC\",\"base\":1500}],\"fltCat\":\"IFR\"},\n"
+    "{\"icaoId\":\"KSQL\",\"obsTime\":1679183220,\"temp\":20,\"dewp\":7,\"wdir\":320,\"wspd\":6,\"visib\":\"10+\",\"altim\":1013.5,"
+    "\"metarType\":\"METAR\",\"rawOb\":\"KSQL 182347Z 32006KT 10SM CLR 20/07 A2993\",\"clouds\":[{\"cover\":\"CLR\",\"base\":null}],\"fltCat\":\"VFR\"},\n"
+    "{\"icaoId\":\"KOAK\",\"obsTime\":1679184300,\"temp\":10,\"dewp\":10,\"wdir\":\"VRB\",\"wspd\":0,\"visib\":0.25,\"altim\":1012.8,"
+    "\"wxString\":\"FG\",\"metarType\":\"SPECI\",\"rawOb\":\"KOAK 190005Z 00000KT 1/4SM FG VV002 10/10 A2991\","
+    "\"clouds\":[{\"cover\":\"OVX\",\"base\":200}],\"fltCat\":\"LIFR\"}]\n";
+
+// a TCP segment's worth, more or less.
+#define REPLAY_CHUNK (1460)
+
+void setUp()
+{
+    memset(&metar_stats, 0, sizeof(metar_stats));
+    reserve_staged(NUM_MAP_STATIONS);
+}
+
+void tearDown()
+{
+    staged_text_reset();
+}
+
+static wx_record_t *find_staged(int num_staged, const char *station)
+{
+    for (int i = 0; i < num_staged; i++) {
+        if (strcmp(staged[i].station, station) == 0) return staged + i;
+    }
+    return NULL;
+}
+
+// what both formats should have staged for the four stations above.
+static void check_staged(int num_staged)
+{
+    TEST_ASSERT_EQUAL_INT(3, num_staged);
+    TEST_ASSERT_EQUAL_UINT32(4, metar_stats.rows);
+    TEST_ASSERT_EQUAL_UINT32(3, metar_stats.applied);
+    TEST_ASSERT_EQUAL_UINT32(1, metar_stats.filtered);
+    TEST_ASSERT_NULL(find_staged(num_staged, "KSQL"));
+
+    wx_record_t *sjc = find_staged(num_staged, "KSJC");
+    TEST_ASSERT_NOT_NULL(sjc);
+    TEST_ASSERT_TRUE(sjc->wx.valid_metar);
+    TEST_ASSERT_EQUAL_INT(WX_COND_VFR, sjc->wx.wx_cond);
+    TEST_ASSERT_EQUAL_INT(1679183220, sjc->wx.obs_time);
+    TEST_ASSERT_EQUAL_STRING("182347Z", sjc->wx.report_time);
+    TEST_ASSERT_EQUAL_INT(160, sjc->wx.wind_dir);
+    TEST_ASSERT_EQUAL_INT(12, sjc->wx.wind_speed);
+    TEST_ASSERT_EQUAL_INT(-1, sjc->wx.wind_gust);      // not reported
+    TEST_ASSERT_EQUAL_FLOAT(10.0, sjc->wx.vis);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 29.94, sjc->wx.altimiter);
+    TEST_ASSERT_EQUAL_FLOAT(21.1, sjc->wx.temp_c);
+    TEST_ASSERT_EQUAL_INT(CLOUD_FEW, sjc->wx.clouds[0].sky_cover);
+    TEST_ASSERT_EQUAL_INT(20000, sjc->wx.clouds[0].altitude);
+    TEST_ASSERT_EQUAL_INT(CLOUD_INVALID, sjc->wx.clouds[1].sky_cover);
+    TEST_ASSERT_FALSE(sjc->wx.speci);
+    TEST_ASSERT_EQUAL_STRING("KSJC 182347Z 16012KT 10SM FEW200 21/06 A2994 RMK AO2 SLP137 T02110061", sjc->wx.metar);
+    TEST_ASSERT_EQUAL_HEX32(WXF_AUTO, sjc->wx.wx_flags);
+
+    wx_record_t *sfo = find_staged(num_staged, "KSFO");
+    TEST_ASSERT_NOT_NULL(sfo);
+    TEST_ASSERT_EQUAL_INT(WX_COND_IFR, sfo->wx.wx_cond);
+    TEST_ASSERT_EQUAL_INT(18, sfo->wx.wind_gust);
+    TEST_ASSERT_EQUAL_FLOAT(2.0, sfo->wx.vis);
+    TEST_ASSERT_EQUAL_INT(CLOUD_BKN, sfo->wx.clouds[0].sky_cover);
+    TEST_ASSERT_EQUAL_INT(800, sfo->wx.clouds[0].altitude);
+    TEST_ASSERT_EQUAL_INT(CLOUD_OVC, sfo->wx.clouds[1].sky_cover);
+    TEST_ASSERT_EQUAL_INT(1500, sfo->wx.clouds[1].altitude);
+    TEST_ASSERT_TRUE(sfo->wx.lightning);
+    TEST_ASSERT_TRUE(sfo->wx.wx_flags & WXF_TS);
+    TEST_ASSERT_TRUE(sfo->wx.wx_flags & WXF_RA);
+    TEST_ASSERT_TRUE(sfo->wx.wx_flags & WXF_LIGHT);
+
+    wx_record_t *oak = find_staged(num_staged, "KOAK");
+    TEST_ASSERT_NOT_NULL(oak);
+    TEST_ASSERT_EQUAL_INT(WX_COND_LIFR, oak->wx.wx_cond);
+    TEST_ASSERT_TRUE(oak->wx.speci);
+    TEST_ASSERT_EQUAL_STRING("190005Z", oak->wx.report_time);
+    TEST_ASSERT_EQUAL_FLOAT(0.25, oak->wx.vis);
+    TEST_ASSERT_EQUAL_INT(CLOUD_OVX, oak->wx.clouds[0].sky_cover);
+    TEST_ASSERT_EQUAL_INT(200, oak->wx.vert_vis);
+    TEST_ASSERT_TRUE(oak->wx.wx_flags & WXF_FG);
+}
+
+static void test_replay_csv()
+{
+    for (size_t chunk : { 1, 7, REPLAY_CHUNK }) {
+        memset(&metar_stats, 0, sizeof(metar_stats));
+        TestStream in(adds_csv, chunk);
+        CSVReader csv(&in);
+        int num_staged = 0;
+        TEST_ASSERT_TRUE(parse_wx(csv, num_staged, true));
+        check_staged(num_staged);
+        staged_text_reset();
+    }
+}
+
+static void test_replay_json()
+{
+    for (size_t chunk : { 1, 7, REPLAY_CHUNK }) {
+        memset(&metar_stats, 0, sizeof(metar_stats));
+        TestStream body(api_json, chunk);
+        CountingStream in(&body);
+        int num_staged = 0;
+        TEST_ASSERT_TRUE(parse_wx_json(in, num_staged, true));
+        TEST_ASSERT_EQUAL_INT(strlen(api_json) - 2, in.bytesRead());     // all but the closing "]\n"
+        check_staged(num_staged);
+        staged_text_reset();
+    }
+}
+
+// nothing new is a good answer, with nothing staged.
+static void test_no_results()
+{
+    TestStream in("No errors\nNo warnings\n3 ms\ndata source=metars\n0 results\n");
+    CSVReader csv(&in);
+    int num_staged = 0;
+    TEST_ASSERT_TRUE(parse_wx(csv, num_staged, false));
+    TEST_ASSERT_EQUAL_INT(0, num_staged);
+
+    TestStream body("[]");
+    CountingStream json(&body);
+    TEST_ASSERT_TRUE(parse_wx_json(json, num_staged, false));
+    TEST_ASSERT_EQUAL_INT(0, num_staged);
+}
+
+// a response cut off part way doesn't parse (JSON), or stops at the last
+// whole row (CSV, which says how many rows there should have been).
+static void test_truncated()
+{
+    std::string csv_text(adds_csv);
+    csv_text.resize(csv_text.find("KSQL 18"));
+    TestStream in(csv_text.c_str(), REPLAY_CHUNK);
+    CSVReader csv(&in);
+    int num_staged = 0;
+    TEST_ASSERT_TRUE(parse_wx(csv, num_staged, true));
+    TEST_ASSERT_EQUAL_INT(2, num_staged);
+    staged_text_reset();
+
+    std::string json_text(api_json);
+    json_text.resize(json_text.find("{\"icaoId\":\"KOAK\"") + 20);
+    TestStream body(json_text.c_str(), REPLAY_CHUNK);
+    CountingStream json(&body);
+    num_staged = 0;
+    TEST_ASSERT_FALSE(parse_wx_json(json, num_staged, true));
+
+    TestStream junk("<html>Service Unavailable</html>");
+    CountingStream not_json(&junk);
+    num_staged = 0;
+    TEST_ASSERT_FALSE(parse_wx_json(not_json, num_staged, true));
+}
+
+// one observation from the JSON API, just the parts these tests look at.
+static std::string api_obs(const char *station, long obs_time, const char *raw, const char *cat)
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf), "{\"icaoId\":\"%s\",\"obsTime\":%ld,\"rawOb\":\"%s\",\"fltCat\":\"%s\"}",
+        station, obs_time, raw, cat);
+    return buf;
+}
+
+// with &hours=N, a station has a report for every hour (and every SPECI);
+// only the newest is staged, whatever order they come in, and the repeats
+// don't use up records the other stations need.
+static void test_repeated_station()
+{
+    std::string json = "[" +
+        api_obs("KSFO", 1679180160, "KSFO 182256Z 28010KT 10SM FEW010 13/11 A2991", "VFR") + "," +
+        api_obs("KSJC", 1679183220, "KSJC 182347Z 16012KT 10SM FEW200 21/06 A2994", "VFR") + "," +
+        api_obs("KSFO", 1679183760, "KSFO 182356Z 29008G18KT 2SM -TSRA BR BKN008 OVC015 12/11 A2990", "IFR") + "," +
+        api_obs("KSFO", 1679180160, "KSFO 182256Z 28010KT 10SM FEW010 13/11 A2991", "VFR") + "," +
+        api_obs("KOAK", 1679184300, "KOAK 190005Z 00000KT 1/4SM FG VV002 10/10 A2991", "LIFR") + "," +
+        api_obs("KOAK", 1679183220, "KOAK 182347Z 00000KT 1/2SM FG VV003 10/10 A2991", "LIFR") + "," +
+        api_obs("KHWD", 1679183220, "KHWD 182347Z 27005KT 10SM CLR 18/08 A2992", "VFR") + "]";
+    TestStream body(json.c_str(), REPLAY_CHUNK);
+    CountingStream in(&body);
+    int num_staged = 0;
+    TEST_ASSERT_TRUE(parse_wx_json(in, num_staged, false));
+    TEST_ASSERT_EQUAL_INT(NUM_MAP_STATIONS, num_staged);
+    TEST_ASSERT_EQUAL_UINT32(7, metar_stats.rows);
+    TEST_ASSERT_EQUAL_UINT32(2, metar_stats.unchanged);   // the first KSFO is replaced, not skipped
+
+    wx_record_t *sfo = find_staged(num_staged, "KSFO");
+    TEST_ASSERT_NOT_NULL(sfo);
+    TEST_ASSERT_EQUAL_INT(1679183760, sfo->wx.obs_time);
+    TEST_ASSERT_EQUAL_INT(WX_COND_IFR, sfo->wx.wx_cond);
+    TEST_ASSERT_TRUE(sfo->wx.lightning);
+    TEST_ASSERT_EQUAL_STRING("KSFO 182356Z 29008G18KT 2SM -TSRA BR BKN008 OVC015 12/11 A2990", sfo->wx.metar);
+    wx_record_t *oak = find_staged(num_staged, "KOAK");
+    TEST_ASSERT_NOT_NULL(oak);
+    TEST_ASSERT_EQUAL_STRING("190005Z", oak->wx.report_time);
+    TEST_ASSERT_EQUAL_INT(200, oak->wx.vert_vis);
+    TEST_ASSERT_NOT_NULL(find_staged(num_staged, "KSJC"));
+    TEST_ASSERT_NOT_NULL(find_staged(num_staged, "KHWD"));
+}
+
+// the same, in the CSV format (the file and replay sources)
+static void test_repeated_station_csv()
+{
+    std::string text(adds_csv);
+    const char *sfo = strstr(adds_csv, "KSFO 18");
+    std::string older(sfo, strchr(sfo, '\n') + 1 - sfo);
+    older.replace(older.find("2023-03-18T23:56:00Z"), 20, "2023-03-18T22:56:00Z");
+    older.replace(older.find(",IFR,"), 5, ",VFR,");
+    text.insert(text.find("KSJC 18"), older);
+    text += older;
+    text.replace(text.find("4 results"), 1, "6");
+    TestStream in(text.c_str(), REPLAY_CHUNK);
+    CSVReader csv(&in);
+    int num_staged = 0;
+    TEST_ASSERT_TRUE(parse_wx(csv, num_staged, true));
+    TEST_ASSERT_EQUAL_INT(3, num_staged);
+    TEST_ASSERT_EQUAL_UINT32(1, metar_stats.unchanged);
+    wx_record_t *rec = find_staged(num_staged, "KSFO");
+    TEST_ASSERT_EQUAL_INT(1679183760, rec->wx.obs_time);
+    TEST_ASSERT_EQUAL_INT(WX_COND_IFR, rec->wx.wx_cond);
+}
+
+// a station's report as commit_airport_wx() would have recorded it.
+static void committed(const char *station, time_t obs_time)
+{
+    int iter = -1;
+    wx_t wx = {};
+    wx.valid_metar = true;
+    wx.obs_time = obs_time;
+    schedule_result(station_airport_index(station, strlen(station), iter), &wx, obs_time + 600);
+}
+
+// the next cycle asks again, and gets what it already has (the server has
+// nothing newer yet), or an older report (still in the &hours window): those
+// rows are skipped before any of the setters run.  only the station with a
+// new report is staged.
+static void test_unchanged_rows()
+{
+    committed("KSJC", 1679183220);
+    committed("KSFO", 1679183760);
+    committed("KOAK", 1679184300);
+    for (int json = 0; json <= 1; json++) {
+        memset(&metar_stats, 0, sizeof(metar_stats));
+        TestStream body(json ? api_json : adds_csv, REPLAY_CHUNK);
+        CountingStream in(&body);
+        CSVReader csv(&in);
+        int num_staged = 0;
+        TEST_ASSERT_TRUE(json ? parse_wx_json(in, num_staged, true) : parse_wx(csv, num_staged, true));
+        TEST_ASSERT_EQUAL_INT(0, num_staged);
+        TEST_ASSERT_EQUAL_UINT32(4, metar_stats.rows);
+        TEST_ASSERT_EQUAL_UINT32(3, metar_stats.unchanged);
+        TEST_ASSERT_EQUAL_UINT32(1, metar_stats.filtered);
+        TEST_ASSERT_EQUAL_UINT32(0, metar_stats.applied);
+    }
+
+    // KSFO has a new report; the old one comes along too.
+    std::string json = "[" +
+        api_obs("KSJC", 1679183220, "KSJC 182347Z 16012KT 10SM FEW200 21/06 A2994", "VFR") + "," +
+        api_obs("KSFO", 1679187360, "KSFO 190056Z 28010KT 10SM SCT015 12/10 A2991", "VFR") + "," +
+        api_obs("KSFO", 1679183760, "KSFO 182356Z 29008G18KT 2SM -TSRA BR BKN008 OVC015 12/11 A2990", "IFR") + "," +
+        api_obs("KOAK", 1679180160, "KOAK 182256Z 00000KT 1/2SM FG VV003 10/10 A2991", "LIFR") + "]";
+    memset(&metar_stats, 0, sizeof(metar_stats));
+    TestStream body(json.c_str(), REPLAY_CHUNK);
+    CountingStream in(&body);
+    int num_staged = 0;
+    TEST_ASSERT_TRUE(parse_wx_json(in, num_staged, false));
+    TEST_ASSERT_EQUAL_INT(1, num_staged);
+    TEST_ASSERT_EQUAL_STRING("KSFO", staged[0].station);
+    TEST_ASSERT_EQUAL_INT(1679187360, staged[0].wx.obs_time);
+    TEST_ASSERT_EQUAL_UINT32(3, metar_stats.unchanged);
+
+    // forget them again, for the other tests.
+    free(sched);
+    schedule_begin(num_airports);
+}
+
+// a bulk sized response (every station the server has, a few of them on
+// the map), in both formats.
+static void bench_replay()
+{
+    const int stations = BENCH_MAP_STATIONS * 100;
+    std::string csv_text(adds_csv, strstr(adds_csv, "KSJC 18") - adds_csv);
+    std::string json_text = "[";
+    const char *csv_row = strstr(adds_csv, "KSFO 18");
+    const char *json_obj = strstr(api_json, "{\"icaoId\":\"KSFO\"");
+    for (int i = 0; i < stations; i++) {
+        // one in a hundred is on the map.
+        char name[8];
+        snprintf(name, sizeof(name), "%c%03d", i % 100 ? 'X' : 'M', i / 100);
+        std::string row(csv_row, strchr(csv_row, '\n') + 1 - csv_row);
+        row.replace(row.find(",KSFO,") + 1, 4, name);
+        csv_text += row;
+        std::string obj(json_obj, strstr(json_obj, "},\n") + 1 - json_obj);
+        obj.replace(obj.find("KSFO"), 4, name);
+        json_text += (i ? "," : "") + obj;
+    }
+    json_text += "]";
+    char *count = strstr(&csv_text[0], "4 results");
+    csv_text.replace(count - csv_text.c_str(), 1, std::to_string(stations));
+
+    const int reps = 10;
+    for (int json = 0; json <= 1; json++) {
+        const std::string &text = json ? json_text : csv_text;
+        double t0 = bench_ns();
+        int staged_total = 0;
+        for (int r = 0; r < reps; r++) {
+            TestStream body(text.c_str(), REPLAY_CHUNK);
+            CountingStream in(&body);
+            CSVReader csv(&in);
+            int num_staged = 0;
+            reserve_staged(stations);
+            bool ok = json ? parse_wx_json(in, num_staged, true) : parse_wx(csv, num_staged, true);
+            TEST_ASSERT_TRUE(ok);
+            staged_total += num_staged;
+            staged_text_reset();
+        }
+        double ns = (bench_ns() - t0) / reps;
+        TEST_ASSERT_EQUAL_INT(reps * BENCH_MAP_STATIONS, staged_total);
+        BENCH("replay %s, %d stations (%zu bytes): %.2f ms, %.1f MB/s, %.0f rows/s\n",
+            json ? "JSON" : "CSV", stations, text.size(), ns / 1e6, text.size() * 1e3 / ns, stations * 1e9 / ns);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    num_airports = NUM_MAP_STATIONS + BENCH_MAP_STATIONS;
+    station_index_init(wx_index, num_airports);
+    for (int i = 0; i < NUM_MAP_STATIONS; i++) station_index_add(wx_index, map_stations[i], i);
+    for (int i = 0; i < BENCH_MAP_STATIONS; i++) {
+        snprintf(bench_ids[i], sizeof(bench_ids[i]), "M%03d", i);
+        station_index_add(wx_index, bench_ids[i], NUM_MAP_STATIONS + i);
+    }
+    schedule_begin(num_airports);
+    metar_fields_begin();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_replay_csv);
+    RUN_TEST(test_replay_json);
+    RUN_TEST(test_no_results);
+    RUN_TEST(test_truncated);
+    RUN_TEST(test_repeated_station);
+    RUN_TEST(test_repeated_station_csv);
+    RUN_TEST(test_unchanged_rows);
+    RUN_TEST(bench_replay);
+    return UNITY_END();
+}
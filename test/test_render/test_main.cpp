@@ -0,0 +1,154 @@
+// wx_snapshot: the render bytes wx_publish() derives from wx[], readers
+// keeping a retired snapshot, and the LED color pass over render[] against
+// the walk over wx_t it replaced.
+#include <unity.h>
+#include <initializer_list>
+#include <FastLED.h>
+#include "test_host.h"
+#include "arena.cpp"
+#include "wx_snapshot.cpp"
+
+#define NUM_AIRPORTS (8)
+
+void setUp() {}
+void tearDown() {}
+
+static void set_wx(wx_snapshot_t *snap, int i, const char *metar, uint8_t cond)
+{
+    wx_t *wx = snap->wx + i;
+    memset(wx, 0, sizeof(*wx));
+    wx->metar = arena_strdup(&snap->text, metar);
+    wx->valid_metar = true;
+    wx->wx_cond = cond;
+}
+
+static void test_render_bytes()
+{
+    wx_snapshot_t *snap = wx_begin_update();
+    set_wx(snap, 0, "KSJC", WX_COND_VFR);
+    set_wx(snap, 1, "KSFO", WX_COND_IFR);
+    snap->wx[1].lightning = true;
+    set_wx(snap, 2, "KOAK", WX_COND_MVFR);
+    snap->wx[2].wind_gust = WX_GUSTY_KT;
+    set_wx(snap, 3, "KRHV", WX_COND_LIFR);
+    snap->wx[3].cached = true;
+    set_wx(snap, 4, "KPAO", 9);
+    set_wx(snap, 5, "KSQL", WX_COND_VFR);
+    snap->wx[5].valid_metar = false;
+    snap->wx[6].metar = NULL;
+    wx_publish(snap);
+
+    const wx_snapshot_t *cur = wx_acquire(WX_READER_UI);
+    TEST_ASSERT_TRUE(cur == snap);
+    TEST_ASSERT_EQUAL_UINT8(WX_RENDER_VALID | WX_COND_VFR, cur->render[0]);
+    TEST_ASSERT_EQUAL_UINT8(WX_RENDER_VALID | WX_COND_IFR | WX_RENDER_LIGHTNING, cur->render[1]);
+    TEST_ASSERT_EQUAL_UINT8(WX_RENDER_VALID | WX_COND_MVFR | WX_RENDER_GUSTY, cur->render[2]);
+    TEST_ASSERT_EQUAL_UINT8(WX_RENDER_VALID | WX_COND_LIFR | WX_RENDER_CACHED, cur->render[3]);
+    TEST_ASSERT_EQUAL_UINT8(WX_RENDER_VALID | WX_RENDER_COND, cur->render[4]);
+    TEST_ASSERT_EQUAL_UINT8(0, cur->render[5]);
+    TEST_ASSERT_EQUAL_UINT8(0, cur->render[6]);
+    wx_release(WX_READER_UI);
+}
+
+// a reader keeps the snapshot it acquired, text and all, while the writer
+// publishes the next one.
+static void test_reader_keeps_snapshot()
+{
+    const wx_snapshot_t *old = wx_acquire(WX_READER_LED);
+    uint32_t generation = old->generation;
+
+    wx_snapshot_t *snap = wx_begin_update();
+    TEST_ASSERT_TRUE(snap != old);
+    TEST_ASSERT_EQUAL_STRING("KSJC", snap->wx[0].metar);
+    TEST_ASSERT_TRUE(snap->wx[0].metar != old->wx[0].metar);
+    set_wx(snap, 0, "KSJC SPECI", WX_COND_IFR);
+    wx_publish(snap);
+
+    TEST_ASSERT_EQUAL_STRING("KSJC", old->wx[0].metar);
+    TEST_ASSERT_EQUAL_UINT8(WX_RENDER_VALID | WX_COND_VFR, old->render[0]);
+    TEST_ASSERT_EQUAL_UINT32(generation, old->generation);
+    wx_release(WX_READER_LED);
+
+    const wx_snapshot_t *cur = wx_acquire(WX_READER_LED);
+    TEST_ASSERT_TRUE(cur == snap);
+    TEST_ASSERT_EQUAL_UINT32(generation + 1, cur->generation);
+    TEST_ASSERT_EQUAL_UINT8(WX_RENDER_VALID | WX_COND_IFR, cur->render[0]);
+    wx_release(WX_READER_LED);
+
+    // and once it's let go, the writer can have it back.
+    TEST_ASSERT_TRUE(wx_begin_update() == old);
+}
+
+static const CRGB cond_colors[WX_COND_MAX] = {
+    CRGB(0, 255, 0), CRGB(0, 0, 255), CRGB(255, 0, 0), CRGB(255, 0, 255),
+};
+static const CRGB invalid_wx(20, 20, 20);
+static const CRGB error_wx(238, 130, 238);
+
+// the color pass as it was, reading each airport's wx_t.
+static int colors_from_wx(const wx_t *wx, CRGB *t_leds, int n)
+{
+    int effects = 0;
+    for (int i = 0; i < n; i++) {
+        if (wx[i].metar == NULL || !wx[i].valid_metar) t_leds[i] = invalid_wx;
+        else if (wx[i].wx_cond >= WX_COND_MAX) t_leds[i] = error_wx;
+        else t_leds[i] = cond_colors[wx[i].wx_cond];
+        if (wx[i].valid_metar && (wx[i].lightning || wx[i].wind_gust >= WX_GUSTY_KT)) effects++;
+    }
+    return effects;
+}
+
+// and as it is, reading each airport's render byte.
+static int colors_from_render(const uint8_t *render, CRGB *t_leds, int n)
+{
+    int effects = 0;
+    for (int i = 0; i < n; i++) {
+        uint8_t r = render[i];
+        uint8_t cond = r & WX_RENDER_COND;
+        if (!(r & WX_RENDER_VALID)) t_leds[i] = invalid_wx;
+        else if (cond >= WX_COND_MAX) t_leds[i] = error_wx;
+        else t_leds[i] = cond_colors[cond];
+        if ((r & WX_RENDER_VALID) && (r & (WX_RENDER_LIGHTNING | WX_RENDER_GUSTY))) effects++;
+    }
+    return effects;
+}
+
+static void bench_color_pass()
+{
+    static char metar[] = "KSJC 121853Z 31008KT 10SM FEW025 18/08 A3001";
+    for (int n : { 100, 500, 2000 }) {
+        wx_t *wx = (wx_t*) calloc(n, sizeof(wx_t));
+        uint8_t *render = (uint8_t*) calloc(n, 1);
+        CRGB *t_leds = (CRGB*) calloc(n, sizeof(CRGB));
+        for (int i = 0; i < n; i++) {
+            wx[i].metar = (i % 17) ? metar : NULL;
+            wx[i].valid_metar = true;
+            wx[i].wx_cond = i % WX_COND_MAX;
+            wx[i].lightning = (i % 23) == 0;
+            wx[i].wind_gust = (i % 11) ? 0 : 30;
+            render[i] = render_byte(wx + i);
+        }
+
+        int frames = 20000;
+        double t = bench_ns();
+        for (int f = 0; f < frames; f++) bench_sink += colors_from_wx(wx, t_leds, n);
+        double walk = (bench_ns() - t) / frames;
+        t = bench_ns();
+        for (int f = 0; f < frames; f++) bench_sink += colors_from_render(render, t_leds, n);
+        double bytes = (bench_ns() - t) / frames;
+        BENCH("color pass, %d airports: wx_t walk %.0f ns, render bytes %.0f ns\n", n, walk, bytes);
+        free(wx);
+        free(render);
+        free(t_leds);
+    }
+}
+
+int main()
+{
+    wx_snapshot_begin(NUM_AIRPORTS);
+    UNITY_BEGIN();
+    RUN_TEST(test_render_bytes);
+    RUN_TEST(test_reader_keeps_snapshot);
+    RUN_TEST(bench_color_pass);
+    return UNITY_END();
+}
@@ -0,0 +1,91 @@
+// station_index: lookups, shared stations, (ptr,len) keys, and lookup
+// cost against the linear strcmp() scan over the airports it replaced.
+#include <unity.h>
+#include <string>
+#include <vector>
+#include "test_host.h"
+#include "station_index.cpp"
+
+static station_index_t idx;
+
+void setUp() { station_index_init(idx, 16); }
+void tearDown() { station_index_free(idx); }
+
+static void test_find()
+{
+    station_index_add(idx, "KSJC", 0);
+    station_index_add(idx, "KRHV", 1);
+    int iter = -1;
+    TEST_ASSERT_EQUAL_INT(1, station_index_find(idx, "KRHV", 4, iter));
+    TEST_ASSERT_EQUAL_INT(-1, station_index_find(idx, "KRHV", 4, iter));
+    iter = -1;
+    TEST_ASSERT_EQUAL_INT(-1, station_index_find(idx, "KSFO", 4, iter));
+}
+
+// several airports get weather from one station.
+static void test_shared_station()
+{
+    station_index_add(idx, "KSJC", 0);
+    station_index_add(idx, "KSJC", 3);
+    station_index_add(idx, "KSJC", 7);
+    int iter = -1, i, seen = 0;
+    while ((i = station_index_find(idx, "KSJC", 4, iter)) != -1) seen |= 1 << i;
+    TEST_ASSERT_EQUAL_INT((1 << 0) | (1 << 3) | (1 << 7), seen);
+}
+
+// keys come straight out of a CSV buffer: not terminated where they end.
+static void test_prefix_keys()
+{
+    station_index_add(idx, "KSJ", 0);
+    station_index_add(idx, "KSJC", 1);
+    const char *row = "KSJCX,...";
+    int iter = -1;
+    TEST_ASSERT_EQUAL_INT(0, station_index_find(idx, row, 3, iter));
+    iter = -1;
+    TEST_ASSERT_EQUAL_INT(1, station_index_find(idx, row, 4, iter));
+    iter = -1;
+    TEST_ASSERT_EQUAL_INT(-1, station_index_find(idx, row, 5, iter));
+}
+
+static void bench_find()
+{
+    for (int n : { 100, 500, 2000 }) {
+        std::vector<std::string> names;
+        for (int i = 0; i < n; i++) {
+            char name[8];
+            snprintf(name, sizeof(name), "K%c%c%c", 'A' + i % 26, 'A' + i / 26 % 26, 'A' + i / 676 % 26);
+            names.push_back(name);
+        }
+        station_index_t big;
+        station_index_init(big, n);
+        for (int i = 0; i < n; i++) station_index_add(big, names[i].c_str(), i);
+
+        int lookups = 200000;
+        double t = bench_ns();
+        for (int k = 0; k < lookups; k++) {
+            const char *key = names[(k * 7919) % n].c_str();
+            for (int i = 0; i < n; i++) {
+                if (strcmp(names[i].c_str(), key) == 0) { bench_sink += i; break; }
+            }
+        }
+        double scan = (bench_ns() - t) / lookups;
+        t = bench_ns();
+        for (int k = 0; k < lookups; k++) {
+            int iter = -1;
+            bench_sink += station_index_find(big, names[(k * 7919) % n].c_str(), 4, iter);
+        }
+        double hashed = (bench_ns() - t) / lookups;
+        BENCH("station lookup, %d airports: scan %.0f ns, station_index %.1f ns\n", n, scan, hashed);
+        station_index_free(big);
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_find);
+    RUN_TEST(test_shared_station);
+    RUN_TEST(test_prefix_keys);
+    RUN_TEST(bench_find);
+    return UNITY_END();
+}
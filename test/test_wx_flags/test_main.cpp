@@ -0,0 +1,132 @@
+// scan_metar: present weather, RVR, vertical visibility and remarks from
+// the raw METAR text, and its cost per report over a corpus of real ones.
+#include <unity.h>
+#include "test_host.h"
+#include "wx_flags.cpp"
+
+static wx_t wx;
+
+void setUp() { memset(&wx, 0, sizeof(wx)); }
+void tearDown() {}
+
+static void scan(const char *text)
+{
+    scan_metar(&wx, text, strlen(text));
+}
+
+static void test_present_weather()
+{
+    scan("KDFW 121853Z 18012G22KT 3SM +TSRA BKN015CB OVC030 24/22 A2990");
+    TEST_ASSERT_EQUAL(WXF_HEAVY | WXF_TS | WXF_RA, wx.wx_flags);
+    TEST_ASSERT_TRUE(wx.lightning);
+
+    scan("KSFO 121856Z 28015KT 10SM VCSH FEW020 SCT040 15/09 A3002");
+    TEST_ASSERT_EQUAL(WXF_VICINITY | WXF_SH, wx.wx_flags);
+    TEST_ASSERT_FALSE(wx.lightning);
+
+    scan("KORD 121851Z 00000KT 1/4SM -FZDZ FZFG VV002 M01/M01 A3011");
+    TEST_ASSERT_EQUAL(WXF_LIGHT | WXF_FZ | WXF_DZ | WXF_FG | WXF_VV, wx.wx_flags);
+    TEST_ASSERT_EQUAL_INT(200, wx.vert_vis);
+    TEST_ASSERT_EQUAL_INT(-1, wx.rvr);
+}
+
+// the station id and cloud groups are made of letters too.
+static void test_not_weather()
+{
+    scan("RASN 121850Z 00000KT 10SM SKC 20/10 A3000");
+    TEST_ASSERT_EQUAL(0, wx.wx_flags);
+    scan("KSJC 121853Z 31008KT 10SM FEW025 BKN250 18/08 A3001");
+    TEST_ASSERT_EQUAL(0, wx.wx_flags);
+    TEST_ASSERT_EQUAL_INT(-1, wx.vert_vis);
+}
+
+static void test_rvr()
+{
+    scan("KSEA 121853Z 17004KT 1/8SM R16L/0600V1000FT R34R/2400FT FG VV001 09/09 A3004");
+    TEST_ASSERT_EQUAL_INT(600, wx.rvr);
+    TEST_ASSERT_TRUE((wx.wx_flags & WXF_RVR) != 0);
+    TEST_ASSERT_EQUAL_INT(100, wx.vert_vis);
+
+    // meters, outside the US
+    scan("EGLL 120650Z 00000KT 0150 R27L/0550N FG VV/// 05/05 Q1020");
+    TEST_ASSERT_EQUAL_INT(550 * 328 / 100, wx.rvr);
+    TEST_ASSERT_EQUAL_INT(-1, wx.vert_vis);
+}
+
+static void test_remarks_and_trend()
+{
+    scan("KMIA 121853Z 09010KT 10SM SCT030CB 31/24 A2995 RMK AO2 LTG DSNT W $");
+    TEST_ASSERT_EQUAL(WXF_AUTO | WXF_LTG | WXF_MAINT, wx.wx_flags);
+    TEST_ASSERT_TRUE(wx.lightning);
+
+    scan("KDEN 121853Z AUTO 36005KT 10SM CLR 12/M03 A3020 RMK AO2 TSNO");
+    TEST_ASSERT_EQUAL(WXF_AUTO | WXF_TSNO, wx.wx_flags);
+    TEST_ASSERT_FALSE(wx.lightning);
+
+    // forecast weather after a trend group doesn't count.
+    scan("EDDF 121850Z 24012KT 9999 -RA BKN012 12/10 Q1008 TEMPO TSRA");
+    TEST_ASSERT_EQUAL(WXF_LIGHT | WXF_RA, wx.wx_flags);
+    TEST_ASSERT_FALSE(wx.lightning);
+}
+
+static const char *corpus[] = {
+    "KSJC 121853Z 31008KT 10SM FEW025 BKN250 18/08 A3001 RMK AO2 SLP162 T01780083",
+    "KSFO 121856Z 28015KT 10SM VCSH FEW020 SCT040 15/09 A3002 RMK AO2 SLP165",
+    "KOAK 121853Z 29012KT 10SM FEW015 17/10 A3001 RMK AO2 SLP161 T01670100",
+    "KLAX 121853Z 25010KT 10SM HZ SCT025 BKN035 21/15 A2996 RMK AO2 SLP145",
+    "KSEA 121853Z 17004KT 1/8SM R16L/0600V1000FT R34R/2400FT FG VV001 09/09 A3004 RMK AO2",
+    "KPDX 121853Z 16008KT 6SM -RA BR OVC012 11/10 A3001 RMK AO2 P0002",
+    "KDEN 121853Z AUTO 36005KT 10SM CLR 12/M03 A3020 RMK AO2 TSNO",
+    "KDFW 121853Z 18012G22KT 3SM +TSRA BKN015CB OVC030 24/22 A2990 RMK AO2 LTG OHD",
+    "KIAH 121853Z 15010KT 7SM -SHRA SCT020 BKN040 27/23 A2995 RMK AO2 RAB35",
+    "KMIA 121853Z 09010KT 10SM SCT030CB 31/24 A2995 RMK AO2 LTG DSNT W $",
+    "KATL 121852Z 24006KT 10SM FEW050 SCT250 28/19 A3002 RMK AO2 SLP164",
+    "KORD 121851Z 00000KT 1/4SM -FZDZ FZFG VV002 M01/M01 A3011 RMK AO2",
+    "KMSP 121853Z 32015G25KT 1SM -SN BLSN OVC008 M08/M10 A3008 RMK AO2",
+    "KDTW 121853Z 27010KT 2SM -SN BR OVC010 M02/M03 A3005 RMK AO2",
+    "KBOS 121854Z 04012KT 3SM -RA BR OVC007 08/07 A2998 RMK AO2",
+    "KJFK 121851Z 20014KT 10SM FEW040 22/14 A3000 RMK AO2 SLP158",
+    "KLGA 121851Z 19012KT 10SM SCT045 23/13 A3000 RMK AO2",
+    "KEWR 121851Z 21010KT 9SM BKN060 22/14 A2999 RMK AO2",
+    "KPHL 121854Z 20008KT 10SM FEW050 24/15 A3001 RMK AO2",
+    "KDCA 121852Z 18009KT 10SM SCT055 26/16 A3000 RMK AO2",
+    "KPHX 121851Z 27008KT 10SM FEW100 38/02 A2985 RMK AO2",
+    "KLAS 121856Z 19012G20KT 10SM FEW120 36/M01 A2987 RMK AO2",
+    "KSLC 121854Z 33010KT 10SM SCT080 25/01 A3003 RMK AO2",
+    "KABQ 121852Z 24015G28KT 5SM BLDU FEW090 29/M04 A3001 RMK AO2",
+    "KOKC 121852Z 19018G26KT 10SM VCTS SCT045CB 30/18 A2988 RMK AO2 LTG DSNT NW",
+    "KMCI 121853Z 17012KT 4SM TSRAGS BKN030CB 26/21 A2992 RMK AO2",
+    "KSTL 121851Z 20008KT 10SM SCT035 29/20 A2996 RMK AO2",
+    "KMSY 121853Z 16006KT 2SM +SHRA BR BKN008 OVC020 25/24 A2993 RMK AO2",
+    "EGLL 120650Z 00000KT 0150 R27L/0550N FG VV/// 05/05 Q1020",
+    "EDDF 121850Z 24012KT 9999 -RA BKN012 12/10 Q1008 TEMPO TSRA",
+};
+
+static void bench_scan()
+{
+    int n = sizeof(corpus) / sizeof(corpus[0]);
+    int lens[sizeof(corpus) / sizeof(corpus[0])];
+    for (int i = 0; i < n; i++) lens[i] = strlen(corpus[i]);
+
+    int rounds = 20000;
+    double t = bench_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < n; i++) {
+            scan_metar(&wx, corpus[i], lens[i]);
+            bench_sink += wx.wx_flags;
+        }
+    }
+    double per = (bench_ns() - t) / ((double) rounds * n);
+    BENCH("scan_metar, %d METARs: %.0f ns per report\n", n, per);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_present_weather);
+    RUN_TEST(test_not_weather);
+    RUN_TEST(test_rvr);
+    RUN_TEST(test_remarks_and_trend);
+    RUN_TEST(bench_scan);
+    return UNITY_END();
+}